@@ -4,205 +4,3659 @@
 #include <iostream>
 #include <functional>
 #include <string>
-#include <map>
+#include <string_view>
 #include <vector>
-#include <any>
+#include <new>
+#include <cstddef>
 #include <tuple>
 #include <utility>
 #include <type_traits>
 #include <algorithm>
 #include <mutex>
+#include <thread>
+#include <exception>
+#include <memory>
+#include <memory_resource>
+#include <atomic>
+#include <cstdint>
+#include <cstring>
+#include <bit>
+#include <deque>
+#include <array>
+#include <span>
+#include <chrono>
+#include <coroutine>
+#include <optional>
+
+//
+// Define EVENTEMITTER_STATS to 1 before including this header to compile in
+// per-event emit counters, per-listener latency histograms and writer lock
+// statistics, read through EventEmitter::stats(). When it is 0 none of that
+// code or state exists.
+//
+#ifndef EVENTEMITTER_STATS
+#define EVENTEMITTER_STATS 0
+#endif
+
+template <typename... Events>
+class TypedEmitter;
+class SharedMemoryEmitter;
+class EventReplay;
+
+//
+// Specialize to let EventRecorder record a type that is not trivially
+// copyable, or that holds pointers:
+//
+//   template <> struct EventSerializer<Order> {
+//     static std::size_t size(const Order& order);
+//     static void write(const Order& order, std::byte* out);  // Writes size(order) bytes.
+//     static Order read(const std::byte* in, std::size_t size);
+//   };
+//
+template <typename T>
+struct EventSerializer {};
+
+template <>
+struct EventSerializer<std::string> {
+  static std::size_t size(const std::string& s) { return s.size(); }
+  static void write(const std::string& s, std::byte* out) { std::memcpy(out, s.data(), s.size()); }
+  static std::string read(const std::byte* in, std::size_t size) { return std::string(reinterpret_cast<const char*>(in), size); }
+};
+
+// Replayed as a view into the log, valid for the emit.
+template <>
+struct EventSerializer<std::string_view> {
+  static std::size_t size(std::string_view s) { return s.size(); }
+  static void write(std::string_view s, std::byte* out) { std::memcpy(out, s.data(), s.size()); }
+  static std::string_view read(const std::byte* in, std::size_t size) { return std::string_view(reinterpret_cast<const char*>(in), size); }
+};
+
+// String literals. Replayed as a pointer into the log, valid for the emit.
+template <>
+struct EventSerializer<const char*> {
+  static std::size_t size(const char* s) { return std::strlen(s) + 1; }
+  static void write(const char* s, std::byte* out) { std::memcpy(out, s, std::strlen(s) + 1); }
+  static const char* read(const std::byte* in, std::size_t) { return reinterpret_cast<const char*>(in); }
+};
 
 class EventEmitter {
-  struct ListenerWrapper {
-    std::any callback;
-    bool is_once;
+  template <typename... Events>
+  friend class TypedEmitter;
+  friend class SharedMemoryEmitter;
+  friend class EventReplay;
+
+public:
+  //
+  // A pre-resolved event. Obtained once from `id(name)`, it lets `on`,
+  // `once`, `emit` and `off` index straight into the event table without
+  // hashing or comparing the name. Only valid for the emitter that issued it.
+  //
+  class EventId {
+    friend class EventEmitter;
+    template <typename... Events>
+    friend class TypedEmitter;
+    std::uint32_t index_ = UINT32_MAX;
+    constexpr explicit EventId(std::uint32_t index) : index_(index) {}
+
+  public:
+    constexpr EventId() = default;
+    constexpr bool operator==(const EventId& other) const { return index_ == other.index_; }
+    constexpr bool operator!=(const EventId& other) const { return index_ != other.index_; }
+  };
+
+  //
+  // A name whose hash is computed at compile time when constructed in a
+  // constant expression, e.g. `"tick"_event` (from eventemitter::literals)
+  // or `static constexpr EventEmitter::EventName tick{"tick"};`.
+  //
+  struct EventName {
+    std::string_view name;
+    std::uint64_t hash;
+
+    constexpr explicit EventName(std::string_view n) : name(n), hash(hash_name(n)) {}
+  };
+
+  // FNV-1a, usable in constant expressions.
+  static constexpr std::uint64_t hash_name(std::string_view name) {
+    std::uint64_t hash = 14695981039346656037ull;
+    for (char c : name) {
+      hash = (hash ^ static_cast<unsigned char>(c)) * 1099511628211ull;
+    }
+    return hash;
+  }
+
+  //
+  // Identifies one listener, as returned by `on` and `once`. Copies refer to
+  // the same listener. A Subscription must not outlive its emitter.
+  //
+  class Subscription {
+    friend class EventEmitter;
+    EventEmitter* emitter_ = nullptr;
+    std::uint32_t slot_ = 0;
+    std::uint32_t generation_ = 0;
+
+    Subscription(EventEmitter* emitter, std::uint32_t slot, std::uint32_t generation)
+      : emitter_(emitter), slot_(slot), generation_(generation) {}
+
+  public:
+    Subscription() = default;
+
+    //
+    // Removes this listener and nothing else, in O(1). Safe to call from a
+    // listener, while other threads emit, and more than once. Returns false
+    // if the listener was already gone (unsubscribed, removed by `off`, or a
+    // once listener that has fired).
+    //
+    bool unsubscribe();
+
+    bool active() const;
+  };
+
+  //
+  // Owns a Subscription and unsubscribes it on destruction, e.g.
+  // `EventEmitter::ScopedSubscription sub = ee.on("tick", cb);`.
+  //
+  class ScopedSubscription {
+    Subscription subscription_;
+
+  public:
+    ScopedSubscription() = default;
+    ScopedSubscription(Subscription subscription) : subscription_(subscription) {}
+    ~ScopedSubscription() { subscription_.unsubscribe(); }
+
+    ScopedSubscription(ScopedSubscription&& other) noexcept
+      : subscription_(std::exchange(other.subscription_, Subscription())) {}
+
+    ScopedSubscription& operator=(ScopedSubscription&& other) noexcept {
+      if (this != &other) {
+        subscription_.unsubscribe();
+        subscription_ = std::exchange(other.subscription_, Subscription());
+      }
+      return *this;
+    }
+
+    ScopedSubscription(const ScopedSubscription&) = delete;
+    ScopedSubscription& operator=(const ScopedSubscription&) = delete;
+
+    bool active() const { return subscription_.active(); }
+
+    // Gives up ownership without unsubscribing.
+    Subscription release() { return std::exchange(subscription_, Subscription()); }
+  };
+
+  //
+  // What a listener returns to decide whether the listeners after it run,
+  // e.g. a filter registered with a high priority returning Stop for the
+  // messages it rejects. Listeners returning anything else, or nothing,
+  // never stop an emit.
+  //
+  enum class Propagation {
+    Continue,
+    Stop
+  };
+
+private:
+  //
+  // Counts what an awaited emit is still waiting for: the dispatch itself
+  // and every coroutine listener it started. Whoever finishes last resumes
+  // the awaiting coroutine.
+  //
+  struct Completion {
+    std::atomic<std::size_t> pending{0};
+    std::coroutine_handle<> awaiting;
+
+    void add() { pending.fetch_add(1, std::memory_order_relaxed); }
+
+    void release() {
+      if (pending.fetch_sub(1, std::memory_order_acq_rel) == 1) {
+        awaiting.resume();
+      }
+    }
+  };
+
+public:
+  //
+  // Return type for coroutine listeners, e.g.
+  // `ee.on("job", [](int id) -> EventEmitter::Task { co_await ...; })`.
+  // An emit starts the coroutine and moves on once it first suspends; the
+  // frame frees itself when the coroutine finishes. emitAwait waits for it.
+  //
+  class Task {
+  public:
+    struct promise_type {
+      Completion* completion = nullptr;
+
+      Task get_return_object() {
+        return Task(std::coroutine_handle<promise_type>::from_promise(*this));
+      }
+
+      std::suspend_always initial_suspend() noexcept { return {}; }
+
+      auto final_suspend() noexcept {
+        struct Finish {
+          bool await_ready() noexcept { return false; }
+          void await_suspend(std::coroutine_handle<promise_type> handle) noexcept {
+            Completion* completion = handle.promise().completion;
+            handle.destroy();
+            if (completion != nullptr) {
+              completion->release();
+            }
+          }
+          void await_resume() noexcept {}
+        };
+        return Finish{};
+      }
+
+      void return_void() {}
+
+      void unhandled_exception() {
+        try {
+          throw;
+        } catch (const std::exception& e) {
+          std::cerr << "Emit error: coroutine listener threw: " << e.what() << std::endl;
+        } catch (...) {
+          std::cerr << "Emit error: coroutine listener threw." << std::endl;
+        }
+      }
+    };
+
+    Task(Task&& other) noexcept : handle_(std::exchange(other.handle_, {})) {}
+    Task& operator=(Task&&) = delete;
+    ~Task() {
+      if (handle_) {
+        handle_.destroy();
+      }
+    }
+
+  private:
+    friend class EventEmitter;
+    std::coroutine_handle<promise_type> handle_;
+
+    explicit Task(std::coroutine_handle<promise_type> handle) : handle_(handle) {}
+
+    //
+    // Runs the coroutine up to its first suspension. From then on it owns
+    // its frame, and `completion`, if given, waits for it to finish.
+    //
+    void start(Completion* completion) {
+      auto handle = std::exchange(handle_, {});
+      handle.promise().completion = completion;
+      if (completion != nullptr) {
+        completion->add();
+      }
+      handle.resume();
+    }
+  };
+
+  //
+  // What emitAsync does when the dispatcher queue for an event is full, and
+  // what an emit does when an Executor's inbox is full.
+  //
+  enum class Backpressure {
+    Block,       // Wait for the dispatcher to make room.
+    DropOldest,  // Discard the oldest queued event to make room.
+    Fail         // Return false without queueing.
+  };
+
+  struct AsyncOptions {
+    std::size_t threads = 1;
+    std::size_t capacity = 1024;  // Per dispatcher thread, rounded up to a power of two.
+    Backpressure backpressure = Backpressure::Block;
+  };
+
+  class Executor;  // Runs listeners on a thread of the caller's choosing; defined below.
+
+  //
+  // Passed to the leak warning handler when a registration takes the
+  // listener count past maxListeners.
+  //
+  struct LeakWarning {
+    std::string_view event;
+    int listeners;
+    int maxListeners;
+  };
+
+  using LeakWarningHandler = std::function<void(const LeakWarning&)>;
+
+  // Emits `size` bytes of written arguments as `name` on `emitter`. Returns
+  // false, without emitting, if they do not hold the arguments of its
+  // signature.
+  using ReplayFn = bool (*)(EventEmitter& emitter, std::string_view name, const std::byte* arguments, std::size_t size);
+
+  //
+  // The arguments of one emit, as handed to an EmitTap. `fingerprint` is 0
+  // when some argument is neither trivially copyable nor has an
+  // EventSerializer; `size`, `write` and `replay` are null then.
+  //
+  struct EmitPayload {
+    std::uint64_t fingerprint;
+    std::size_t (*size)(const void* arguments);
+    void (*write)(const void* arguments, std::byte* out);  // Writes size(arguments) bytes.
+    ReplayFn replay;
+    const void* arguments;
+  };
+
+  //
+  // Sees every emit and emitAsync call, on the calling thread, before it is
+  // dispatched. See EventRecorder in record.hxx.
+  //
+  class EmitTap {
+  public:
+    virtual ~EmitTap() = default;
+    virtual void tap(std::string_view name, const EmitPayload& payload) = 0;
+  };
+
+  //
+  // Log-bucketed histogram in the style of HdrHistogram: every power of two
+  // is split into four linear sub-buckets, so a recorded value is known to
+  // within 25%. Values from 2^40 up share the last bucket.
+  //
+  class Histogram {
+  public:
+    static constexpr std::size_t SUB_BUCKETS = 4;
+    static constexpr std::size_t MAX_BITS = 40;
+    static constexpr std::size_t BUCKETS = (MAX_BITS - 1) * SUB_BUCKETS;
+
+    static constexpr std::size_t bucket_of(std::uint64_t value) {
+      if (value < SUB_BUCKETS) {
+        return std::size_t(value);
+      }
+      std::size_t bit = std::bit_width(value) - 1;
+      if (bit >= MAX_BITS) {
+        return BUCKETS - 1;
+      }
+      return (bit - 1) * SUB_BUCKETS + std::size_t((value >> (bit - 2)) & (SUB_BUCKETS - 1));
+    }
+
+    // The largest value that falls into `bucket`.
+    static constexpr std::uint64_t bucket_limit(std::size_t bucket) {
+      if (bucket < SUB_BUCKETS) {
+        return bucket;
+      }
+      if (bucket == BUCKETS - 1) {
+        return UINT64_MAX;
+      }
+      std::size_t bit = bucket / SUB_BUCKETS + 1;
+      std::uint64_t sub = bucket % SUB_BUCKETS;
+      return ((SUB_BUCKETS + sub + 1) << (bit - 2)) - 1;
+    }
+
+    void record(std::uint64_t value, std::uint64_t count = 1) {
+      counts_[bucket_of(value)] += count;
+    }
+
+    std::uint64_t count() const {
+      std::uint64_t total = 0;
+      for (std::uint64_t c : counts_) {
+        total += c;
+      }
+      return total;
+    }
+
+    //
+    // The smallest bucket limit at or below which `p` percent (0-100) of the
+    // recorded values fall, or 0 if nothing was recorded.
+    //
+    std::uint64_t percentile(double p) const {
+      std::uint64_t total = count();
+      if (total == 0) {
+        return 0;
+      }
+      auto target = std::uint64_t(p / 100.0 * double(total));
+      std::uint64_t seen = 0;
+      for (std::size_t i = 0; i < BUCKETS; ++i) {
+        seen += counts_[i];
+        if (seen > target || seen == total) {
+          return bucket_limit(i);
+        }
+      }
+      return bucket_limit(BUCKETS - 1);
+    }
+
+    const std::array<std::uint64_t, BUCKETS>& buckets() const { return counts_; }
+
+  private:
+    std::array<std::uint64_t, BUCKETS> counts_ = {};
+  };
+
+  struct ListenerStats {
+    bool once = false;
+    Histogram call_ns;  // Time spent in each call, in nanoseconds.
+  };
+
+  struct EventStats {
+    std::string name;
+    std::size_t shard = 0;  // The writer shard its listeners are registered under.
+    std::uint64_t emits = 0;  // Dispatches, counting every item of a batch.
+    std::vector<ListenerStats> listeners;  // Current listeners, in call order.
+  };
+
+  //
+  // A snapshot returned by stats(). Empty unless EVENTEMITTER_STATS is 1.
+  //
+  struct Stats {
+    std::vector<EventStats> events;
+    std::uint64_t lock_waits = 0;           // Writer lock acquisitions that had to wait.
+    std::uint64_t lock_wait_ns = 0;         // Total time spent waiting for them.
+    std::uint64_t snapshots_published = 0;  // Listener lists built and published.
+    std::uint64_t listeners_allocated = 0;  // Listener nodes allocated.
+  };
+
+  static constexpr bool stats_enabled = EVENTEMITTER_STATS != 0;
+
+private:
+  //
+  // One address per decayed argument list, so a signature check is a single
+  // pointer comparison.
+  //
+  template <typename... Args>
+  static constexpr char signature_tag = 0;
+
+  //
+  // Type-erased callable with inline storage. Callables that fit in
+  // INLINE_CAPACITY bytes and are nothrow-movable are stored in place; larger
+  // ones go to the heap. The invoker is kept untyped together with the
+  // signature it was created for, and is only cast back once the caller has
+  // matched that signature. Heap targets come from the memory resource given
+  // to `create`, and copies allocate from the same one.
+  //
+  class InlineFunction {
+  public:
+    static constexpr std::size_t INLINE_CAPACITY = 48;
+
+  private:
+    struct Ops {
+      void (*copy)(const InlineFunction& from, InlineFunction& to);
+      void (*move)(InlineFunction& from, InlineFunction& to) noexcept;
+      void (*destroy)(InlineFunction& self) noexcept;
+    };
+
+    struct HeapTarget {
+      void* target;
+      std::pmr::memory_resource* resource;
+    };
+
+    alignas(std::max_align_t) unsigned char storage_[INLINE_CAPACITY];
+    void (*invoke_)() = nullptr;
+    const void* signature_ = nullptr;
+    const Ops* ops_ = nullptr;
+
+    template <typename Fn>
+    static constexpr bool is_inline =
+      sizeof(Fn) <= INLINE_CAPACITY &&
+      alignof(Fn) <= alignof(std::max_align_t) &&
+      std::is_nothrow_move_constructible_v<Fn>;
+
+    template <typename Fn>
+    static Fn* target(const InlineFunction& self) {
+      auto* storage = const_cast<unsigned char*>(self.storage_);
+      if constexpr (is_inline<Fn>) {
+        return std::launder(reinterpret_cast<Fn*>(storage));
+      } else {
+        return static_cast<Fn*>(reinterpret_cast<HeapTarget*>(storage)->target);
+      }
+    }
+
+    template <typename Fn, typename... CtorArgs>
+    static void construct(InlineFunction& self, std::pmr::memory_resource* resource, CtorArgs&&... args) {
+      if constexpr (is_inline<Fn>) {
+        ::new (static_cast<void*>(self.storage_)) Fn(std::forward<CtorArgs>(args)...);
+      } else {
+        std::pmr::polymorphic_allocator<> allocator(resource);
+        Fn* fn = allocator.new_object<Fn>(std::forward<CtorArgs>(args)...);
+        ::new (static_cast<void*>(self.storage_)) HeapTarget{fn, resource};
+      }
+    }
+
+    template <typename Fn>
+    static constexpr Ops ops_for = {
+      [](const InlineFunction& from, InlineFunction& to) {
+        if constexpr (!std::is_copy_constructible_v<Fn>) {
+          // Move-only targets are only used for queued tasks, which are never copied.
+          std::terminate();
+        } else if constexpr (is_inline<Fn>) {
+          construct<Fn>(to, nullptr, *target<Fn>(from));
+        } else {
+          construct<Fn>(to, reinterpret_cast<const HeapTarget*>(from.storage_)->resource, *target<Fn>(from));
+        }
+      },
+      [](InlineFunction& from, InlineFunction& to) noexcept {
+        if constexpr (is_inline<Fn>) {
+          ::new (static_cast<void*>(to.storage_)) Fn(std::move(*target<Fn>(from)));
+          target<Fn>(from)->~Fn();
+        } else {
+          ::new (static_cast<void*>(to.storage_)) HeapTarget(*reinterpret_cast<HeapTarget*>(from.storage_));
+        }
+      },
+      [](InlineFunction& self) noexcept {
+        if constexpr (is_inline<Fn>) {
+          target<Fn>(self)->~Fn();
+        } else {
+          std::pmr::polymorphic_allocator<> allocator(reinterpret_cast<HeapTarget*>(self.storage_)->resource);
+          allocator.delete_object(target<Fn>(self));
+        }
+      }
+    };
+
+    template <typename Fn, typename R, typename... Args>
+    static R invoke_as(const InlineFunction& self, Args... args) {
+      return static_cast<R>((*target<Fn>(self))(std::forward<Args>(args)...));
+    }
+
+  public:
+    //
+    // `Args` are the exact parameter types the callable is invoked with.
+    //
+    template <typename... Args, typename Fn>
+    static InlineFunction create(Fn&& fn, std::pmr::memory_resource* resource) {
+      return create_returning<void, Args...>(std::forward<Fn>(fn), resource);
+    }
+
+    //
+    // Like create, for callers that need the callable's result. The result
+    // type is not part of the signature; whoever invokes the function has to
+    // know it.
+    //
+    template <typename R, typename... Args, typename Fn>
+    static InlineFunction create_returning(Fn&& fn, std::pmr::memory_resource* resource) {
+      using Target = std::decay_t<Fn>;
+      InlineFunction result;
+      construct<Target>(result, resource, std::forward<Fn>(fn));
+      result.invoke_ = reinterpret_cast<void (*)()>(&invoke_as<Target, R, Args...>);
+      result.signature_ = &signature_tag<Args...>;
+      result.ops_ = &ops_for<Target>;
+      return result;
+    }
+
+    InlineFunction() = default;
+    ~InlineFunction() {
+      if (ops_) {
+        ops_->destroy(*this);
+      }
+    }
+
+    InlineFunction(const InlineFunction& other)
+      : invoke_(other.invoke_), signature_(other.signature_), ops_(other.ops_) {
+      if (ops_) {
+        ops_->copy(other, *this);
+      }
+    }
+
+    InlineFunction(InlineFunction&& other) noexcept
+      : invoke_(other.invoke_), signature_(other.signature_), ops_(other.ops_) {
+      if (ops_) {
+        ops_->move(other, *this);
+        other.ops_ = nullptr;
+      }
+    }
+
+    InlineFunction& operator=(InlineFunction other) noexcept {
+      this->~InlineFunction();
+      ::new (static_cast<void*>(this)) InlineFunction(std::move(other));
+      return *this;
+    }
+
+    const void* signature() const { return signature_; }
+
+    //
+    // The caller must have checked that `signature()` is
+    // `&signature_tag<Args...>`.
+    //
+    template <typename... Args, typename... CallArgs>
+    void invoke(CallArgs&&... args) const {
+      invoke_returning<void, Args...>(std::forward<CallArgs>(args)...);
+    }
+
+    //
+    // For functions made by `create_returning<R, Args...>`.
+    //
+    template <typename R, typename... Args, typename... CallArgs>
+    R invoke_returning(CallArgs&&... args) const {
+      auto fn = reinterpret_cast<R (*)(const InlineFunction&, Args...)>(invoke_);
+      return fn(*this, std::forward<CallArgs>(args)...);
+    }
+  };
+
+#if EVENTEMITTER_STATS
+  class AtomicHistogram {
+    std::atomic<std::uint64_t> counts_[Histogram::BUCKETS] = {};
+
+  public:
+    void record(std::uint64_t value) {
+      counts_[Histogram::bucket_of(value)].fetch_add(1, std::memory_order_relaxed);
+    }
+
+    Histogram snapshot() const {
+      Histogram result;
+      for (std::size_t i = 0; i < Histogram::BUCKETS; ++i) {
+        if (std::uint64_t count = counts_[i].load(std::memory_order_relaxed)) {
+          result.record(Histogram::bucket_limit(i), count);
+        }
+      }
+      return result;
+    }
+  };
+#endif
+
+  //
+  // Counters kept per writer lock. Empty unless stats are compiled in.
+  //
+  struct WriterCounters {
+#if EVENTEMITTER_STATS
+    std::atomic<std::uint64_t> lock_waits{0};
+    std::atomic<std::uint64_t> lock_wait_ns{0};
+    std::atomic<std::uint64_t> snapshots_published{0};
+    std::atomic<std::uint64_t> listeners_allocated{0};
+#endif
+  };
+
+  //
+  // What a callback returns, for the results emit acts on. Anything else is
+  // dropped.
+  //
+  enum class ResultKind : std::uint8_t {
+    None,
+    Propagation,  // May stop the emit.
+    Task          // A coroutine to start.
+  };
+
+  template <typename R>
+  static constexpr ResultKind result_kind =
+    std::is_same_v<R, Propagation> ? ResultKind::Propagation
+    : std::is_same_v<R, Task>      ? ResultKind::Task
+                                   : ResultKind::None;
+
+  // The type a callback of kind `Kind` is stored as returning.
+  template <ResultKind Kind>
+  using result_type_t = std::conditional_t<Kind == ResultKind::Propagation, Propagation,
+    std::conditional_t<Kind == ResultKind::Task, Task, void>>;
+
+  //
+  // What an executor-bound listener shares with the deliveries queued for
+  // it. Removing the listener clears `active`, so deliveries still in the
+  // inbox are dropped.
+  //
+  struct ExecutorBinding {
+    Executor* executor;
+    std::atomic<bool> active{true};
+
+    explicit ExecutorBinding(Executor* e) : executor(e) {}
+  };
+
+  template <typename Fn>
+  struct BoundCallback : ExecutorBinding {
+    Fn fn;
+
+    BoundCallback(Executor* e, Fn f) : ExecutorBinding(e), fn(std::move(f)) {}
+  };
+
+  //
+  // A registered listener. Lists hold pointers to these rather than copies,
+  // so registration copies pointers only, and clearing `active` hides the
+  // listener from emits that are already iterating a list holding it. An
+  // emit claims a once listener by being the one to clear `active`. A
+  // pattern listener's node is shared by the lists of every event the
+  // pattern matches and is owned by its Pattern, not by those lists.
+  //
+  struct Listener {
+    InlineFunction callback;
+    bool is_once = false;
+    bool from_pattern = false;
+    ResultKind result = ResultKind::None;
+    int priority = 0;
+    std::uint32_t slot = 0;  // Subscription slot, or Pattern index if `from_pattern`.
+    std::atomic<bool> active{true};
+    std::shared_ptr<ExecutorBinding> binding;  // Set for listeners bound to an Executor.
+#if EVENTEMITTER_STATS
+    mutable AtomicHistogram call_ns;
+#endif
+  };
+
+  //
+  // Listener lists are immutable once published. Registration copies the
+  // current list, inserts into the copy and swaps the pointer, so emit()
+  // only has to take a reference to whatever list is current. Lists are
+  // kept in call order: higher priority first, then registration order.
+  // `signature` is set when every listener shares one, which lets emit()
+  // check it once for the whole list, and `has_results` is only set when
+  // some listener returns Propagation or Task, so lists without one never
+  // look at results.
+  //
+  struct ListenerList {
+    std::pmr::vector<Listener*> listeners;
+    const void* signature = nullptr;
+    bool has_results = false;
+
+    explicit ListenerList(std::pmr::memory_resource* resource) : listeners(resource) {}
+
+    void push_back(Listener* listener) {
+      if (listeners.empty()) {
+        signature = listener->callback.signature();
+      } else if (signature != listener->callback.signature()) {
+        signature = nullptr;
+      }
+      has_results = has_results || listener->result != ResultKind::None;
+      listeners.push_back(listener);
+    }
+  };
+
+  //
+  // How a listener is called, fixed when it is registered.
+  //
+  struct ListenerOptions {
+    bool is_once = false;
+    ResultKind result = ResultKind::None;
+    int priority = 0;
+    std::shared_ptr<ExecutorBinding> binding = nullptr;
+  };
+
+  //
+  // A coroutine suspended in `co_await next(...)`. Waiters live in the
+  // awaiting coroutine's frame and are linked into their event's stack, so
+  // waiting allocates nothing.
+  //
+  struct Waiter {
+    Waiter* next = nullptr;
+    const void* signature = nullptr;
+    void (*resume)(Waiter& self, const void* arguments) = nullptr;  // Takes the arguments and resumes.
+  };
+
+  //
+  // An Event is created the first time a name is seen and stays until it
+  // is left with no listeners, by off(name), by unsubscribing or by its
+  // once listeners firing, and nothing holds it. Its slot is then reused
+  // for another name once no reader can still see it. Handing out an
+  // EventId pins the event, so ids stay valid for the life of the emitter.
+  // Each one gets its own cache line, so publishing a list for one event
+  // never invalidates a neighbour's.
+  //
+  static constexpr std::uint32_t PINNED = std::uint32_t(1) << 30;
+  static constexpr std::uint32_t RELEASED = std::uint32_t(1) << 31;
+
+  struct alignas(64) Event {
+    std::atomic<const ListenerList*> listeners{nullptr};
+    std::atomic<Waiter*> waiters{nullptr};  // Newest first.
+    std::pmr::string name;
+    std::uint64_t hash = 0;
+    std::uint32_t index = 0;
+    std::size_t tombstones = 0;  // Unsubscribed listeners still in the list. Writers only.
+    // PINNED, plus one per queued emit or coroutine pointing at the event,
+    // or RELEASED once it has been released.
+    std::atomic<std::uint32_t> holds{0};
+    // Set while the event waits in compactions_, linked through `next_compaction`.
+    std::atomic<bool> compacting{false};
+    Event* next_compaction = nullptr;
+#if EVENTEMITTER_STATS
+    std::atomic<std::uint64_t> emits{0};
+#endif
+
+    explicit Event(std::pmr::memory_resource* resource) : name(resource) {}
+  };
+
+  //
+  // Open-addressed name -> Event table, kept at most half full. Slots are
+  // only ever filled in place, so readers can probe it while a writer
+  // inserts; growing publishes a new table and retires the old one.
+  //
+  struct NameIndex {
+    // Left in the slot of a released event, so probes go on past it.
+    static inline Event* const RELEASED_SLOT = reinterpret_cast<Event*>(alignof(Event));
+
+    std::size_t mask;
+    mutable std::size_t used = 0;  // Slots no longer empty, released ones included. Writers only.
+    mutable std::pmr::vector<std::atomic<Event*>> slots;  // Filled in place, see above.
+
+    NameIndex(std::size_t capacity, std::pmr::memory_resource* resource)
+      : mask(capacity - 1), slots(capacity, resource) {}
+
+    void insert(Event* event) const {
+      std::size_t i = event->hash & mask;
+      for (;; i = (i + 1) & mask) {
+        Event* slot = slots[i].load(std::memory_order_relaxed);
+        if (slot == nullptr) {
+          used++;
+          break;
+        }
+        if (slot == RELEASED_SLOT) {
+          break;
+        }
+      }
+      slots[i].store(event, std::memory_order_release);
+    }
+
+    void erase(const Event* event) const {
+      std::size_t i = event->hash & mask;
+      while (slots[i].load(std::memory_order_relaxed) != event) {
+        i = (i + 1) & mask;
+      }
+      slots[i].store(RELEASED_SLOT, std::memory_order_release);
+    }
+  };
+
+  //
+  // Takes a hold on `event` unless it has been released, which it only
+  // does once nothing holds it.
+  //
+  static bool hold(Event& event) {
+    std::uint32_t holds = event.holds.load(std::memory_order_relaxed);
+    do {
+      if (holds & RELEASED) {
+        return false;
+      }
+    } while (!event.holds.compare_exchange_weak(holds, holds + 1, std::memory_order_acquire, std::memory_order_relaxed));
+    return true;
+  }
+
+  //
+  // Owns a hold taken with hold(), for queued emits and coroutines that keep
+  // pointing at an event after their epoch guard is gone.
+  //
+  class EventHold {
+    EventEmitter* emitter_ = nullptr;
+    Event* event_ = nullptr;
+
+  public:
+    EventHold() = default;
+    EventHold(EventEmitter* emitter, Event* event) : emitter_(emitter), event_(event) {}
+    EventHold(EventHold&& other) noexcept
+      : emitter_(other.emitter_), event_(std::exchange(other.event_, nullptr)) {}
+    EventHold& operator=(EventHold&& other) noexcept {
+      std::swap(emitter_, other.emitter_);
+      std::swap(event_, other.event_);
+      return *this;
+    }
+
+    //
+    // The last hold on an event left without listeners queues it for
+    // release, which the hold kept from happening.
+    //
+    ~EventHold() {
+      if (event_ != nullptr && event_->holds.fetch_sub(1, std::memory_order_release) == 1 &&
+          event_->listeners.load() == nullptr) {
+        emitter_->schedule_compaction(*event_);
+      }
+    }
+
+    Event* get() const { return event_; }
+  };
+
+  //
+  // Events live in segments that double in size and never move, so an
+  // EventId maps to its Event with a couple of bit operations and readers
+  // never race with growth. Segment `k` holds `2^(k + FIRST_SEGMENT_BITS)`
+  // events.
+  //
+  static constexpr std::size_t FIRST_SEGMENT_BITS = 5;
+  static constexpr std::size_t MAX_SEGMENTS = 32 - FIRST_SEGMENT_BITS;
+
+  static std::size_t segment_size(std::size_t segment) {
+    return std::size_t(1) << (segment + FIRST_SEGMENT_BITS);
+  }
+
+  static std::pair<std::size_t, std::size_t> locate(std::uint32_t index) {
+    std::size_t biased = std::size_t(index) + segment_size(0);
+    std::size_t bit = std::bit_width(biased) - 1;
+    return {bit - FIRST_SEGMENT_BITS, biased - (std::size_t(1) << bit)};
+  }
+
+  //
+  // Readers never take a lock. They enter the domain by bumping a counter on
+  // their own cache line, and writers retire what they unpublish instead of
+  // deleting it. Writers only advance the epoch once every reader that
+  // entered two epochs ago has left, so anything retired at epoch `e` can be
+  // freed as soon as the epoch reaches `e + 2`.
+  //
+  class EpochDomain {
+    static constexpr std::size_t STRIPES = 32;
+
+    struct alignas(64) Stripe {
+      std::atomic<std::size_t> readers[2] = {};
+    };
+
+    struct Retired {
+      std::uint64_t epoch;
+      const void* ptr;
+      void (*destroy)(const void*, std::pmr::memory_resource*);
+    };
+
+    Stripe stripes_[STRIPES];
+    std::atomic<std::uint64_t> epoch_{0};
+
+    static std::size_t stripe_index() {
+      static std::atomic<std::size_t> next_index{0};
+      static thread_local const std::size_t index = next_index++ % STRIPES;
+      return index;
+    }
+
+    bool try_advance() {
+      std::uint64_t epoch = epoch_.load();
+      for (const auto& stripe : stripes_) {
+        if (stripe.readers[(epoch + 1) & 1].load() != 0) {
+          return false;
+        }
+      }
+      // Writers under different locks may race to advance; only one wins.
+      return epoch_.compare_exchange_strong(epoch, epoch + 1);
+    }
+
+  public:
+    class Guard {
+      std::atomic<std::size_t>* counter_;
+
+    public:
+      explicit Guard(EpochDomain& domain) {
+        Stripe& stripe = domain.stripes_[stripe_index()];
+        for (;;) {
+          std::uint64_t epoch = domain.epoch_.load();
+          counter_ = &stripe.readers[epoch & 1];
+          counter_->fetch_add(1);
+          if (domain.epoch_.load() == epoch) {
+            break;
+          }
+          counter_->fetch_sub(1, std::memory_order_release);
+        }
+      }
+      ~Guard() { counter_->fetch_sub(1, std::memory_order_release); }
+
+      Guard(const Guard&) = delete;
+      Guard& operator=(const Guard&) = delete;
+    };
+
+    //
+    // Objects waiting to be freed. Every writer lock owns one, so writers
+    // holding different locks never touch the same list. Everything retired
+    // to it must have been allocated from its memory resource.
+    //
+    class RetireList {
+      friend class EpochDomain;
+      std::pmr::vector<Retired> retired_;
+      std::size_t collect_at_ = 1;
+
+    public:
+      explicit RetireList(std::pmr::memory_resource* resource) : retired_(resource) {}
+      ~RetireList() {
+        for (const auto& entry : retired_) {
+          entry.destroy(entry.ptr, retired_.get_allocator().resource());
+        }
+      }
+
+      RetireList(const RetireList&) = delete;
+      RetireList& operator=(const RetireList&) = delete;
+    };
+
+    //
+    // Writers only, with the lock that owns `list` held.
+    //
+    template <typename T>
+    void retire(RetireList& list, const T* ptr) {
+      if (ptr == nullptr) {
+        return;
+      }
+      list.retired_.push_back({epoch_.load(), ptr, [](const void* p, std::pmr::memory_resource* resource) {
+        std::pmr::polymorphic_allocator<>(resource).delete_object(const_cast<T*>(static_cast<const T*>(p)));
+      }});
+      // Amortized, so retiring many objects in one operation stays linear.
+      if (list.retired_.size() >= list.collect_at_) {
+        collect(list);
+        list.collect_at_ = std::max<std::size_t>(list.retired_.size() * 2, 1);
+      }
+    }
+
+    //
+    // Waits until every reader that entered before the call has left. Must
+    // not be called by a reader.
+    //
+    void synchronize() {
+      std::uint64_t target = epoch_.load() + 2;
+      while (epoch_.load() < target) {
+        if (!try_advance()) {
+          std::this_thread::yield();
+        }
+      }
+    }
+
+    //
+    // For writers that reuse an object in place instead of retiring it: the
+    // epoch to note when it becomes unreachable, and whether every reader
+    // that could still see it since then has left.
+    //
+    std::uint64_t epoch() const {
+      return epoch_.load();
+    }
+
+    bool passed(std::uint64_t epoch) {
+      if (epoch + 2 > epoch_.load()) {
+        try_advance();
+        try_advance();
+      }
+      return epoch + 2 <= epoch_.load();
+    }
+
+    void collect(RetireList& list) {
+      try_advance();
+      try_advance();
+
+      std::uint64_t epoch = epoch_.load();
+      auto it = std::remove_if(list.retired_.begin(), list.retired_.end(), [&](const Retired& entry) {
+        if (entry.epoch + 2 > epoch) {
+          return false;
+        }
+        entry.destroy(entry.ptr, list.retired_.get_allocator().resource());
+        return true;
+      });
+      list.retired_.erase(it, list.retired_.end());
+    }
   };
 
-  std::map<std::string, std::vector<ListenerWrapper>> events;
-  int _listeners = 0;
-  mutable std::mutex mtx_;
+  //
+  // Bounded multi-producer/multi-consumer queue of tasks (Vyukov). Each cell
+  // carries a sequence number that tells producers and consumers whether it
+  // is free for the lap they are on, so neither side ever takes a lock.
+  //
+  class TaskQueue {
+    struct alignas(64) Cell {
+      std::atomic<std::size_t> sequence{0};
+      InlineFunction task;
+    };
+
+    std::unique_ptr<Cell[]> cells_;
+    std::size_t mask_;
+    alignas(64) std::atomic<std::size_t> tail_{0};
+    alignas(64) std::atomic<std::size_t> head_{0};
+
+  public:
+    explicit TaskQueue(std::size_t capacity) {
+      std::size_t size = std::bit_ceil(std::max<std::size_t>(capacity, 2));
+      cells_.reset(new Cell[size]);
+      mask_ = size - 1;
+      for (std::size_t i = 0; i < size; ++i) {
+        cells_[i].sequence.store(i, std::memory_order_relaxed);
+      }
+    }
+
+    bool try_push(InlineFunction& task) {
+      std::size_t pos = tail_.load(std::memory_order_relaxed);
+      for (;;) {
+        Cell& cell = cells_[pos & mask_];
+        std::size_t sequence = cell.sequence.load(std::memory_order_acquire);
+        auto diff = static_cast<std::ptrdiff_t>(sequence - pos);
+        if (diff == 0) {
+          if (tail_.compare_exchange_weak(pos, pos + 1, std::memory_order_relaxed)) {
+            cell.task = std::move(task);
+            cell.sequence.store(pos + 1, std::memory_order_release);
+            return true;
+          }
+        } else if (diff < 0) {
+          return false;
+        } else {
+          pos = tail_.load(std::memory_order_relaxed);
+        }
+      }
+    }
+
+    bool try_pop(InlineFunction& task) {
+      std::size_t pos = head_.load(std::memory_order_relaxed);
+      for (;;) {
+        Cell& cell = cells_[pos & mask_];
+        std::size_t sequence = cell.sequence.load(std::memory_order_acquire);
+        auto diff = static_cast<std::ptrdiff_t>(sequence - (pos + 1));
+        if (diff == 0) {
+          if (head_.compare_exchange_weak(pos, pos + 1, std::memory_order_relaxed)) {
+            task = std::move(cell.task);
+            cell.sequence.store(pos + mask_ + 1, std::memory_order_release);
+            return true;
+          }
+        } else if (diff < 0) {
+          return false;
+        } else {
+          pos = head_.load(std::memory_order_relaxed);
+        }
+      }
+    }
+
+    // Number of tasks ever accepted.
+    std::size_t pushed() const { return tail_.load(); }
+  };
+
+  //
+  // A pool of dispatcher threads, each draining its own TaskQueue. Tasks are
+  // routed by event, so every event is always dispatched by the same thread
+  // and in the order it was queued.
+  //
+  class AsyncDispatcher {
+    struct Worker {
+      TaskQueue queue;
+      std::atomic<std::uint32_t> signal{0};
+      std::atomic<bool> sleeping{false};
+      alignas(64) std::atomic<std::size_t> completed{0};
+      std::thread thread;
+
+      explicit Worker(std::size_t capacity) : queue(capacity) {}
+    };
+
+    std::vector<std::unique_ptr<Worker>> workers_;
+    Backpressure backpressure_;
+    std::atomic<bool> stopping_{false};
+    std::atomic<int> draining_{0};
+
+    void complete(Worker& worker) {
+      worker.completed.fetch_add(1);
+      if (draining_.load() > 0) {
+        worker.completed.notify_all();
+      }
+    }
+
+    void run(Worker& worker) {
+      static constexpr int SPINS_BEFORE_SLEEP = 64;
+      InlineFunction task;
+      int idle = 0;
+      for (;;) {
+        std::uint32_t seen = worker.signal.load();
+        if (worker.queue.try_pop(task)) {
+          task.invoke<>();
+          task = InlineFunction();
+          complete(worker);
+          idle = 0;
+          continue;
+        }
+        if (stopping_.load()) {
+          return;
+        }
+        if (++idle < SPINS_BEFORE_SLEEP) {
+          std::this_thread::yield();
+          continue;
+        }
+        // Producers only pay for a wake-up when the worker is really asleep.
+        worker.sleeping.store(true);
+        if (worker.signal.load() == seen) {
+          worker.signal.wait(seen);
+        }
+        worker.sleeping.store(false);
+      }
+    }
+
+    static void wake(Worker& worker) {
+      worker.signal.fetch_add(1);
+      if (worker.sleeping.load()) {
+        worker.signal.notify_one();
+      }
+    }
+
+  public:
+    explicit AsyncDispatcher(const AsyncOptions& options)
+      : backpressure_(options.backpressure) {
+      std::size_t threads = std::max<std::size_t>(options.threads, 1);
+      for (std::size_t i = 0; i < threads; ++i) {
+        workers_.push_back(std::make_unique<Worker>(options.capacity));
+      }
+      for (auto& worker : workers_) {
+        worker->thread = std::thread([this, w = worker.get()] { run(*w); });
+      }
+    }
+
+    //
+    // Dispatches whatever is still queued, then joins the threads.
+    //
+    ~AsyncDispatcher() {
+      stopping_.store(true);
+      for (auto& worker : workers_) {
+        wake(*worker);
+      }
+      for (auto& worker : workers_) {
+        worker->thread.join();
+      }
+    }
+
+    bool push(std::size_t key, InlineFunction& task) {
+      Worker& worker = *workers_[key % workers_.size()];
+
+      while (!worker.queue.try_push(task)) {
+        if (backpressure_ == Backpressure::Fail) {
+          return false;
+        }
+        if (backpressure_ == Backpressure::DropOldest) {
+          InlineFunction dropped;
+          if (worker.queue.try_pop(dropped)) {
+            complete(worker);
+          }
+        } else {
+          std::this_thread::yield();
+        }
+      }
+
+      wake(worker);
+      return true;
+    }
+
+    //
+    // Waits until every task queued before the call has been dispatched or
+    // dropped. Must not be called from a dispatcher thread.
+    //
+    void drain() {
+      draining_.fetch_add(1);
+      for (auto& worker : workers_) {
+        std::size_t target = worker->queue.pushed();
+        for (std::size_t done = worker->completed.load(); done < target; done = worker->completed.load()) {
+          worker->completed.wait(done);
+        }
+      }
+      draining_.fetch_sub(1);
+    }
+  };
+
+public:
+  //
+  // Runs listeners on the thread that owns it, e.g. a UI or I/O loop:
+  // `ee.on("done", cb, executor)` makes emit copy the arguments into the
+  // executor's lock-free inbox, and the owning loop calls them with poll().
+  // Deliveries queued by one thread are polled in the order they were
+  // queued. An executor must outlive the listeners bound to it.
+  //
+  class Executor {
+    friend class EventEmitter;
+    TaskQueue inbox_;
+    std::function<void()> wake_;
+    Backpressure backpressure_;
+    std::atomic<bool> scheduled_{false};
+    std::atomic<std::thread::id> owner_{};
+    std::atomic<std::size_t> dropped_{0};
+
+    //
+    // When the inbox is full, Block waits for the owner to poll, or polls
+    // here if the owner is the one emitting. DropOldest discards the oldest
+    // queued delivery and Fail the new one; both count it in dropped().
+    //
+    void push(InlineFunction& task) {
+      while (!inbox_.try_push(task)) {
+        if (backpressure_ == Backpressure::Fail) {
+          dropped_.fetch_add(1, std::memory_order_relaxed);
+          return;
+        }
+        if (backpressure_ == Backpressure::DropOldest) {
+          InlineFunction oldest;
+          if (inbox_.try_pop(oldest)) {
+            dropped_.fetch_add(1, std::memory_order_relaxed);
+          }
+        } else if (owner_.load(std::memory_order_relaxed) == std::this_thread::get_id()) {
+          poll();
+        } else {
+          std::this_thread::yield();
+        }
+      }
+      if (wake_ && !scheduled_.exchange(true)) {
+        wake_();
+      }
+    }
+
+  public:
+    //
+    // `capacity` deliveries fit in the inbox, rounded up to a power of two.
+    // `wake`, if given, is called on the emitting thread when the first
+    // delivery lands in an inbox that has been polled since the last call,
+    // so a loop that sleeps between polls is woken once per batch rather
+    // than once per emit. `backpressure` says what an emit does when the
+    // inbox is full.
+    //
+    explicit Executor(std::size_t capacity = 4096, std::function<void()> wake = nullptr,
+                      Backpressure backpressure = Backpressure::Block)
+      : inbox_(capacity), wake_(std::move(wake)), backpressure_(backpressure) {}
+
+    Executor(const Executor&) = delete;
+    Executor& operator=(const Executor&) = delete;
+
+    //
+    // Calls up to `max` queued deliveries on this thread and returns how
+    // many ran. The thread that polls is taken to be the owner.
+    //
+    std::size_t poll(std::size_t max = SIZE_MAX) {
+      owner_.store(std::this_thread::get_id(), std::memory_order_relaxed);
+      if (wake_) {
+        scheduled_.store(false);
+      }
+      InlineFunction task;
+      std::size_t ran = 0;
+      while (ran < max && inbox_.try_pop(task)) {
+        task.invoke<>();
+        task = InlineFunction();
+        ++ran;
+      }
+      if (ran == max && wake_ && !scheduled_.exchange(true)) {
+        wake_();  // What was left still needs a poll.
+      }
+      return ran;
+    }
+
+    //
+    // Deliveries discarded because the inbox was full, under
+    // Backpressure::DropOldest or Backpressure::Fail.
+    //
+    std::size_t dropped() const {
+      return dropped_.load(std::memory_order_relaxed);
+    }
+  };
+
+private:
+  std::atomic<Event*> segments_[MAX_SEGMENTS] = {};
+  std::atomic<std::uint32_t> event_count_{0};
+  std::atomic<const NameIndex*> index_{nullptr};
+  EpochDomain epoch_;
+  //
+  // Maps a Subscription to its listener. A slot's generation changes every
+  // time it is released, so a token outliving its listener never matches a
+  // listener that reuses the slot. Writers only.
+  //
+  struct SubscriptionSlot {
+    Listener* listener = nullptr;
+    Event* event = nullptr;
+    std::uint32_t generation = 0;
+  };
+
+  //
+  // Writers are split by the hash of the event name. Each shard has its own
+  // lock, retired objects, subscription slots and listener count on cache
+  // lines of its own, so registering or removing a listener only contends
+  // with writers of events in the same shard.
+  //
+  static constexpr std::size_t SHARD_BITS = 4;
+  static constexpr std::size_t SHARDS = std::size_t(1) << SHARD_BITS;
+
+  struct alignas(64) Shard {
+    std::mutex mtx;
+    EpochDomain::RetireList retired;
+    std::pmr::vector<SubscriptionSlot> subscription_slots;
+    std::pmr::vector<std::uint32_t> free_subscription_slots;
+    std::atomic<int> listeners{0};
+    [[no_unique_address]] WriterCounters counters;
+
+    explicit Shard(std::pmr::memory_resource* resource)
+      : retired(resource), subscription_slots(resource), free_subscription_slots(resource) {}
+  };
+
+  template <std::size_t... I>
+  static std::array<Shard, SHARDS> make_shards(std::pmr::memory_resource* resource, std::index_sequence<I...>) {
+    return {{(static_cast<void>(I), Shard(resource))...}};
+  }
+
+  //
+  // Everything the emitter allocates for listeners, snapshots, names and
+  // retire lists comes from here, so it is declared before the members that
+  // allocate from it.
+  //
+  std::pmr::memory_resource* resource_;
+  std::array<Shard, SHARDS> shards_;
+
+  //
+  // A wildcard subscription such as "order.*" or "order.**". Its listener is
+  // added to the list of every event whose name it matches: events that
+  // already exist when it is registered, and events interned later. So a
+  // name is matched against the patterns once, when it is first seen, and
+  // never on emit. Guarded by mtx_; a slot is free while `listener` is null.
+  //
+  struct Pattern {
+    std::pmr::string text;
+    Listener* listener = nullptr;
+    std::uint32_t generation = 0;
+    std::uint64_t order = 0;  // Registration order, for listeners added to new events.
+
+    explicit Pattern(std::pmr::memory_resource* resource) : text(resource) {}
+  };
+
+  // Set in Subscription tokens that refer to a Pattern.
+  static constexpr std::uint32_t PATTERN_TOKEN = std::uint32_t(1) << 31;
+
+  //
+  // Emitter-wide lock, for interning new names, pattern subscriptions and
+  // starting the async dispatcher. Pattern changes take shard locks while
+  // holding it; nothing takes it while holding a shard lock.
+  //
+  std::mutex mtx_;
+  EpochDomain::RetireList retired_{resource_};
+  std::pmr::vector<Pattern> patterns_{resource_};
+  std::pmr::vector<std::uint32_t> free_patterns_{resource_};
+  std::uint64_t next_pattern_order_ = 0;
+  std::atomic<int> pattern_count_{0};      // Patterns registered, fired or not.
+  std::atomic<int> pattern_listeners_{0};  // Patterns whose listener is still active.
+
+  //
+  // Hashes of names emitted while patterns are registered that match none
+  // of them, so resolve() does not check them against every pattern again.
+  // A fixed number of sets of UNMATCHED_WAYS entries each, so it stays the
+  // same size however many names are emitted, and a few hundred names that
+  // keep coming back do not evict each other. Written with mtx_ held, and
+  // cleared when a pattern is added.
+  //
+  static constexpr std::size_t UNMATCHED_SETS = 512;
+  static constexpr std::size_t UNMATCHED_WAYS = 4;
+
+  struct alignas(UNMATCHED_WAYS * sizeof(std::uint64_t)) UnmatchedSet {
+    std::array<std::atomic<std::uint64_t>, UNMATCHED_WAYS> hashes{};
+  };
+  std::array<UnmatchedSet, UNMATCHED_SETS> unmatched_{};
+  std::size_t unmatched_victim_ = 0;
+  std::atomic<AsyncDispatcher*> async_{nullptr};
+  std::atomic<EmitTap*> tap_{nullptr};
+  LeakWarningHandler leak_warning_handler_;
+  [[no_unique_address]] WriterCounters counters_;
+
+  //
+  // Slots of the released events, oldest first, with the epoch they were
+  // released at. intern() reuses one once no reader can still see its old
+  // name. Guarded by mtx_.
+  //
+  struct ReleasedEvent {
+    std::uint32_t index;
+    std::uint64_t epoch;
+  };
+  std::pmr::deque<ReleasedEvent> released_{resource_};
+
+  // Events waiting for compact_scheduled(), newest first. See schedule_compaction.
+  std::atomic<Event*> compactions_{nullptr};
+
+  //
+  // The fmix64 finalizer of MurmurHash3. The high bits of an FNV-1a hash
+  // barely change with the last characters of a name, so "metric.0" to
+  // "metric.99" would share a couple of shards without it.
+  //
+  static constexpr std::uint64_t mix_hash(std::uint64_t hash) {
+    hash ^= hash >> 33;
+    hash *= 0xff51afd7ed558ccdull;
+    hash ^= hash >> 33;
+    hash *= 0xc4ceb9fe1a85ec53ull;
+    hash ^= hash >> 33;
+    return hash;
+  }
+
+  static std::size_t shard_index(std::uint64_t hash) {
+    // The name index probes from the low bits, so shards use the high ones.
+    return std::size_t(mix_hash(hash) >> (64 - SHARD_BITS));
+  }
+
+  Shard& shard_of(const Event& event) {
+    return shards_[shard_index(event.hash)];
+  }
+
+  template <typename Callable>
+  struct traits : public traits<decltype(&std::decay_t<Callable>::operator())> {};
+
+  template <typename ClassType, typename R, typename... Args>
+  struct traits<R(ClassType::*)(Args...) const> {
+    using ReturnType = R; using ArgumentTypesAsTuple = std::tuple<Args...>;
+    using OriginalFunctionType = std::function<R(Args...)>;
+    using StoredFunctionType = std::function<void(std::decay_t<Args>...)>;
+  };
+  template <typename ClassType, typename R, typename... Args>
+  struct traits<R(ClassType::*)(Args...) const noexcept> {
+    using ReturnType = R; using ArgumentTypesAsTuple = std::tuple<Args...>;
+    using OriginalFunctionType = std::function<R(Args...)>;
+    using StoredFunctionType = std::function<void(std::decay_t<Args>...)>;
+  };
+  template <typename ClassType, typename R, typename... Args>
+  struct traits<R(ClassType::*)(Args...) > {
+    using ReturnType = R; using ArgumentTypesAsTuple = std::tuple<Args...>;
+    using OriginalFunctionType = std::function<R(Args...)>;
+    using StoredFunctionType = std::function<void(std::decay_t<Args>...)>;
+  };
+  template <typename ClassType, typename R, typename... Args>
+  struct traits<R(ClassType::*)(Args...) noexcept> {
+    using ReturnType = R; using ArgumentTypesAsTuple = std::tuple<Args...>;
+    using OriginalFunctionType = std::function<R(Args...)>;
+    using StoredFunctionType = std::function<void(std::decay_t<Args>...)>;
+  };
+  template <typename R, typename... Args>
+  struct traits<R(*)(Args...)> {
+    using ReturnType = R; using ArgumentTypesAsTuple = std::tuple<Args...>;
+    using OriginalFunctionType = std::function<R(Args...)>;
+    using StoredFunctionType = std::function<void(std::decay_t<Args>...)>;
+  };
+  template <typename R, typename... Args>
+  struct traits<R(*)(Args...) noexcept> {
+    using ReturnType = R; using ArgumentTypesAsTuple = std::tuple<Args...>;
+    using OriginalFunctionType = std::function<R(Args...)>;
+    using StoredFunctionType = std::function<void(std::decay_t<Args>...)>;
+  };
+  template <typename R, typename... Args>
+  struct traits<std::function<R(Args...)>> {
+    using ReturnType = R; using ArgumentTypesAsTuple = std::tuple<Args...>;
+    using OriginalFunctionType = std::function<R(Args...)>;
+    using StoredFunctionType = std::function<void(std::decay_t<Args>...)>;
+  };
+
+  //
+  // Listeners on the dynamic API are invoked with `const T&` to the caller's
+  // arguments, so `const T&` parameters bind without a copy and by-value
+  // parameters copy once. `T&&` parameters get a copy of their own.
+  //
+  template <typename Param, typename T>
+  static decltype(auto) adapt_argument(const T& arg) {
+    if constexpr (std::is_rvalue_reference_v<Param>) {
+      return std::decay_t<Param>(arg);
+    } else {
+      return (arg);
+    }
+  }
+
+  template <typename Callback>
+  static constexpr ResultKind callback_result =
+    result_kind<typename traits<std::decay_t<Callback>>::ReturnType>;
+
+  //
+  // Listeners returning Propagation or Task keep their result; any other
+  // result is dropped.
+  //
+  template <typename Callback, typename... Args>
+  InlineFunction to_inline_function(Callback&& cb, std::tuple<Args...>*) {
+    using Result = result_type_t<callback_result<Callback>>;
+    if constexpr ((std::is_rvalue_reference_v<Args> || ...)) {
+      return InlineFunction::create_returning<Result, const std::decay_t<Args>&...>(
+        [fn = std::decay_t<Callback>(std::forward<Callback>(cb))](const std::decay_t<Args>&... args) mutable -> decltype(auto) {
+          return fn(adapt_argument<Args>(args)...);
+        }, resource_);
+    } else {
+      return InlineFunction::create_returning<Result, const std::decay_t<Args>&...>(std::forward<Callback>(cb), resource_);
+    }
+  }
+
+  //
+  // `target` is an Event or, for a name not yet interned, an EventName.
+  //
+  template <typename Target, typename Callback>
+  Subscription add_listener(Target& target, Callback&& cb, bool is_once_flag, int priority,
+                            std::shared_ptr<ExecutorBinding> binding = nullptr) {
+    using Arguments = typename traits<std::decay_t<Callback>>::ArgumentTypesAsTuple;
+    InlineFunction storable_func = to_inline_function(
+      std::forward<Callback>(cb), static_cast<Arguments*>(nullptr));
+
+    return subscribe(target, std::move(storable_func), {is_once_flag, callback_result<Callback>, priority, std::move(binding)});
+  }
+
+  //
+  // Wraps `cb` in a listener that copies its arguments into `executor`'s
+  // inbox instead of calling it. The binding, the callback and the queued
+  // deliveries use the global heap, since the executor may hold deliveries
+  // after the emitter is gone.
+  //
+  template <typename Callback, typename... Args>
+  static auto bind_to_executor(Callback&& cb, Executor& executor, std::tuple<Args...>*) {
+    using Fn = std::decay_t<Callback>;
+    auto bound = std::make_shared<BoundCallback<Fn>>(&executor, Fn(std::forward<Callback>(cb)));
+    auto deliver = [bound](const std::decay_t<Args>&... args) {
+      InlineFunction task = InlineFunction::create<>(
+        [bound, captured = std::tuple<std::decay_t<Args>...>(args...)]() mutable {
+          if (!bound->active.load(std::memory_order_acquire)) {
+            return;
+          }
+          std::apply([&](std::decay_t<Args>&... values) {
+            if constexpr (callback_result<Fn> == ResultKind::Task) {
+              bound->fn(pass_captured<Args>(values)...).start(nullptr);
+            } else {
+              bound->fn(pass_captured<Args>(values)...);
+            }
+          }, captured);
+        }, std::pmr::new_delete_resource());
+      bound->executor->push(task);
+    };
+    return std::make_pair(std::move(deliver), std::shared_ptr<ExecutorBinding>(bound));
+  }
+
+  // A delivery owns its copies, so `T&&` parameters get them moved in.
+  template <typename Param, typename T>
+  static decltype(auto) pass_captured(T& value) {
+    if constexpr (std::is_rvalue_reference_v<Param>) {
+      return std::move(value);
+    } else {
+      return static_cast<const T&>(value);
+    }
+  }
+
+  template <typename Callback>
+  static auto bind_to_executor(Callback&& cb, Executor& executor) {
+    using Arguments = typename traits<std::decay_t<Callback>>::ArgumentTypesAsTuple;
+    return bind_to_executor(std::forward<Callback>(cb), executor, static_cast<Arguments*>(nullptr));
+  }
+
+  //
+  // Writers only, when `listener` stops being active: drops the deliveries
+  // of a bound listener that are still queued.
+  //
+  static void unbind(Listener& listener) {
+    if (listener.binding) {
+      listener.binding->active.store(false, std::memory_order_release);
+    }
+  }
+
+  //
+  // Registers `callback` under the event's shard lock, then runs the leak
+  // check with no lock held.
+  //
+  Subscription subscribe(Event& event, InlineFunction callback, const ListenerOptions& options) {
+    Shard& shard = shard_of(event);
+    Subscription subscription;
+    {
+      auto lock = acquire(shard.mtx, shard.counters);
+      subscription = insert_listener(shard, event, std::move(callback), options);
+    }
+    check_listener_limit(event.name);
+    return subscription;
+  }
+
+  //
+  // Interns `name` and registers `callback` on its event. The guard keeps
+  // an event released meanwhile from being reused for another name, so the
+  // release is seen under the shard lock and the name is interned again.
+  //
+  Subscription subscribe(const EventName& name, InlineFunction callback, const ListenerOptions& options) {
+    Subscription subscription;
+    for (bool added = false; !added;) {
+      EpochDomain::Guard guard(epoch_);
+      Event& event = intern(name.name, name.hash);
+      Shard& shard = shard_of(event);
+      auto lock = acquire(shard.mtx, shard.counters);
+      if (!(event.holds.load(std::memory_order_relaxed) & RELEASED)) {
+        subscription = insert_listener(shard, event, std::move(callback), options);
+        added = true;
+      }
+    }
+    check_listener_limit(name.name);
+    return subscription;
+  }
+
+  void check_listener_limit(std::string_view name) {
+    int total = listener_count();
+    if (total <= this->maxListeners) {
+      return;
+    }
+
+    LeakWarning warning{name, total, this->maxListeners};
+    LeakWarningHandler handler;
+    {
+      auto lock = acquire(mtx_, counters_);
+      handler = leak_warning_handler_;
+    }
+    if (handler) {
+      handler(warning);
+    } else {
+      std::cout
+        << "warning: possible EventEmitter memory leak detected. "
+        << warning.listeners
+        << " listeners added (max is " << warning.maxListeners
+        << "). For event: " << warning.event
+        << std::endl;
+    }
+  }
+
+  //
+  // Takes a writer lock, recording how long it had to wait when stats are
+  // compiled in.
+  //
+  static std::unique_lock<std::mutex> acquire(std::mutex& mtx, [[maybe_unused]] WriterCounters& counters) {
+#if EVENTEMITTER_STATS
+    std::unique_lock<std::mutex> lock(mtx, std::try_to_lock);
+    if (!lock.owns_lock()) {
+      auto started = std::chrono::steady_clock::now();
+      lock.lock();
+      counters.lock_waits.fetch_add(1, std::memory_order_relaxed);
+      counters.lock_wait_ns.fetch_add(elapsed_ns(started), std::memory_order_relaxed);
+    }
+    return lock;
+#else
+    return std::unique_lock<std::mutex>(mtx);
+#endif
+  }
+
+#if EVENTEMITTER_STATS
+  static std::uint64_t elapsed_ns(std::chrono::steady_clock::time_point started) {
+    return std::uint64_t(std::chrono::duration_cast<std::chrono::nanoseconds>(
+      std::chrono::steady_clock::now() - started).count());
+  }
+#endif
+
+  //
+  // Times one listener call into the listener's histogram. Does nothing
+  // unless stats are compiled in.
+  //
+  class CallTimer {
+#if EVENTEMITTER_STATS
+    const Listener& listener_;
+    std::chrono::steady_clock::time_point started_ = std::chrono::steady_clock::now();
+
+  public:
+    explicit CallTimer(const Listener& listener) : listener_(listener) {}
+    ~CallTimer() { listener_.call_ns.record(elapsed_ns(started_)); }
+#else
+  public:
+    explicit CallTimer(const Listener&) {}
+#endif
+    CallTimer(const CallTimer&) = delete;
+    CallTimer& operator=(const CallTimer&) = delete;
+  };
+
+  static void count_emits([[maybe_unused]] Event& event, [[maybe_unused]] std::size_t count = 1) {
+#if EVENTEMITTER_STATS
+    event.emits.fetch_add(count, std::memory_order_relaxed);
+#endif
+  }
+
+  //
+  // Writers only, with the event's shard locked.
+  //
+  Subscription insert_listener(Shard& shard, Event& event, InlineFunction callback, const ListenerOptions& options) {
+    shard.listeners++;
+#if EVENTEMITTER_STATS
+    shard.counters.listeners_allocated.fetch_add(1, std::memory_order_relaxed);
+#endif
+
+    Listener* listener = make_listener_node(std::move(callback), options);
+
+    if (shard.free_subscription_slots.empty()) {
+      listener->slot = std::uint32_t(shard.subscription_slots.size());
+      shard.subscription_slots.emplace_back();
+    } else {
+      listener->slot = shard.free_subscription_slots.back();
+      shard.free_subscription_slots.pop_back();
+    }
+    SubscriptionSlot& slot = shard.subscription_slots[listener->slot];
+    slot.listener = listener;
+    slot.event = &event;
+
+    republish(shard, event, listener);
+
+    // The token carries the shard in its low bits.
+    std::uint32_t token = (listener->slot << SHARD_BITS) | std::uint32_t(shard_index(event.hash));
+    return Subscription(this, token, slot.generation);
+  }
+
+  Listener* make_listener_node(InlineFunction callback, const ListenerOptions& options) {
+    auto listener = allocator().new_object<Listener>();
+    listener->callback = std::move(callback);
+    listener->is_once = options.is_once;
+    listener->result = options.result;
+    listener->priority = options.priority;
+    listener->binding = options.binding;
+    return listener;
+  }
+
+  //
+  // Writers only. Hides `listener` from emits unless one has already claimed
+  // it, and frees its subscription slot. The node itself stays in the
+  // event's list until the list is republished or cleared.
+  //
+  bool deactivate(Shard& shard, Listener& listener) {
+    bool was_active = listener.active.exchange(false);
+    if (was_active) {
+      shard.listeners--;
+      unbind(listener);
+    }
+    SubscriptionSlot& slot = shard.subscription_slots[listener.slot];
+    if (slot.listener == &listener) {
+      slot.listener = nullptr;
+      slot.event = nullptr;
+      slot.generation++;
+      shard.free_subscription_slots.push_back(listener.slot);
+    }
+    return was_active;
+  }
+
+  //
+  // Writers only. Publishes a copy of the event's list without the
+  // listeners that were unsubscribed or have fired once, with `added`
+  // inserted after every listener of the same or higher priority if given,
+  // then retires the old list and what it dropped. An event left with no
+  // listeners is released.
+  //
+  void republish(Shard& shard, Event& event, Listener* added = nullptr) {
+    const ListenerList* current = event.listeners.load();
+
+    auto next = allocator().new_object<ListenerList>(resource_);
+    bool inserted = added == nullptr;
+    if (current != nullptr) {
+      next->listeners.reserve(current->listeners.size() + 1);
+      for (Listener* listener : current->listeners) {
+        if (!inserted && listener->priority < added->priority) {
+          next->push_back(added);
+          inserted = true;
+        }
+        if (listener->active.load()) {
+          next->push_back(listener);
+        }
+      }
+    }
+    if (!inserted) {
+      next->push_back(added);
+    }
+    if (next->listeners.empty()) {
+      allocator().delete_object(next);
+      next = nullptr;
+    }
+    event.listeners.store(next);
+    event.tombstones = 0;
+    if (next == nullptr) {
+      schedule_compaction(event);
+    }
+#if EVENTEMITTER_STATS
+    shard.counters.snapshots_published.fetch_add(1, std::memory_order_relaxed);
+#endif
+
+    if (current == nullptr) {
+      return;
+    }
+    // `next` keeps the order of `current`, so whatever is not next in line
+    // there was dropped. An emit may claim a kept listener meanwhile, so
+    // `active` cannot be re-read to decide this.
+    std::size_t kept = 0;
+    for (Listener* listener : current->listeners) {
+      if (next != nullptr && kept < next->listeners.size() && next->listeners[kept] == added) {
+        kept++;
+      }
+      if (next != nullptr && kept < next->listeners.size() && next->listeners[kept] == listener) {
+        kept++;
+        continue;
+      }
+      if (listener->from_pattern) {
+        continue;  // Its Pattern retires it.
+      }
+      deactivate(shard, *listener);
+      epoch_.retire(shard.retired, listener);
+    }
+    epoch_.retire(shard.retired, current);
+  }
+
+  //
+  // Backs Subscription::unsubscribe. The list is only rebuilt once more
+  // than half of it is tombstones, so each removal is O(1) amortized.
+  // Returns false if an emit claimed the listener first.
+  //
+  bool unsubscribe(std::uint32_t token, std::uint32_t generation) {
+    if (token & PATTERN_TOKEN) {
+      auto lock = acquire(mtx_, counters_);
+      std::uint32_t index = token & ~PATTERN_TOKEN;
+      if (!is_pattern_subscribed(index, generation)) {
+        return false;
+      }
+      return remove_pattern(index);
+    }
+
+    Shard& shard = shards_[token & (SHARDS - 1)];
+    std::uint32_t slot_index = token >> SHARD_BITS;
+    auto lock = acquire(shard.mtx, shard.counters);
+    if (!is_subscribed(shard, slot_index, generation)) {
+      return false;
+    }
+
+    SubscriptionSlot& slot = shard.subscription_slots[slot_index];
+    Event& event = *slot.event;
+    bool removed = deactivate(shard, *slot.listener);
+
+    if (++event.tombstones * 2 > event.listeners.load()->listeners.size()) {
+      republish(shard, event);
+    }
+    return removed;
+  }
+
+  bool is_subscribed(std::uint32_t token, std::uint32_t generation) {
+    if (token & PATTERN_TOKEN) {
+      auto lock = acquire(mtx_, counters_);
+      return is_pattern_subscribed(token & ~PATTERN_TOKEN, generation);
+    }
+    Shard& shard = shards_[token & (SHARDS - 1)];
+    auto lock = acquire(shard.mtx, shard.counters);
+    return is_subscribed(shard, token >> SHARD_BITS, generation);
+  }
+
+  //
+  // Writers only, with `shard` locked.
+  //
+  static bool is_subscribed(const Shard& shard, std::uint32_t slot_index, std::uint32_t generation) {
+    return slot_index < shard.subscription_slots.size() &&
+      shard.subscription_slots[slot_index].generation == generation &&
+      shard.subscription_slots[slot_index].listener != nullptr &&
+      shard.subscription_slots[slot_index].listener->active.load();
+  }
+
+  //
+  // With mtx_ held.
+  //
+  bool is_pattern_subscribed(std::uint32_t index, std::uint32_t generation) const {
+    return index < patterns_.size() &&
+      patterns_[index].generation == generation &&
+      patterns_[index].listener != nullptr &&
+      patterns_[index].listener->active.load();
+  }
+
+  int listener_count() const {
+    int total = pattern_listeners_.load(std::memory_order_relaxed);
+    for (const Shard& shard : shards_) {
+      total += shard.listeners.load(std::memory_order_relaxed);
+    }
+    return total;
+  }
+
+  //
+  // Interns `name`, creating its Event and indexing it under mtx_ if this is
+  // the first time it has been seen, or since it was released. For
+  // callers holding an epoch guard and not mtx_. Through an index the guard
+  // read before a release, the result may already be released; the guard
+  // keeps its slot from being reused until it is left.
+  //
+  Event& intern(std::string_view name, std::uint64_t hash) {
+    if (Event* existing = find_event(name, hash)) {
+      return *existing;
+    }
+
+    auto lock = acquire(mtx_, counters_);
+    if (Event* existing = find_event(name, hash)) {
+      return *existing;
+    }
+    compact_scheduled();
+
+    std::uint32_t count = event_count_.load(std::memory_order_relaxed);
+    Event* reused = nullptr;
+    if (!released_.empty() && epoch_.passed(released_.front().epoch)) {
+      reused = &event_at(released_.front().index);
+      released_.pop_front();
+    }
+
+    Event* event = reused;
+    if (event == nullptr) {
+      auto [segment, offset] = locate(count);
+      Event* events = segments_[segment].load(std::memory_order_relaxed);
+      if (events == nullptr) {
+        events = allocator().allocate_object<Event>(segment_size(segment));
+        for (std::size_t i = 0; i < segment_size(segment); ++i) {
+          ::new (static_cast<void*>(events + i)) Event(resource_);
+        }
+        segments_[segment].store(events, std::memory_order_release);
+      }
+      event = &events[offset];
+      event->index = count;
+    }
+
+    event->name = name;
+    event->hash = hash;
+    event->holds.store(0, std::memory_order_relaxed);
+#if EVENTEMITTER_STATS
+    event->emits.store(0, std::memory_order_relaxed);
+#endif
+    // No other writer can reach the event before it is indexed below, so
+    // its first list is stored without the shard lock.
+    event->listeners.store(match_patterns(*event));
+
+    const NameIndex* current = index_.load();
+    if (current == nullptr || (current->used + 1) * 2 > current->mask + 1) {
+      // Rebuilt without the released slots, at least a quarter full.
+      std::size_t live = 1;
+      for (std::uint32_t i = 0; i < count; ++i) {
+        live += !(event_at(i).holds.load(std::memory_order_relaxed) & RELEASED);
+      }
+      std::size_t capacity = std::max<std::size_t>(std::bit_ceil(live * 4), 64);
+      auto next = allocator().new_object<NameIndex>(capacity, resource_);
+      for (std::uint32_t i = 0; i < count; ++i) {
+        Event& other = event_at(i);
+        if (&other != event && !(other.holds.load(std::memory_order_relaxed) & RELEASED)) {
+          next->insert(&other);
+        }
+      }
+      next->insert(event);
+      index_.store(next);
+      epoch_.retire(retired_, current);
+    } else {
+      current->insert(event);
+    }
+
+    if (reused == nullptr) {
+      event_count_.store(count + 1, std::memory_order_release);
+    }
+    return *event;
+  }
+
+  //
+  // Interns `name` and takes a hold on its Event.
+  //
+  EventHold intern_held(std::string_view name, std::uint64_t hash) {
+    for (;;) {
+      EpochDomain::Guard guard(epoch_);
+      Event& event = intern(name, hash);
+      if (hold(event)) {
+        return EventHold(this, &event);
+      }
+    }
+  }
+
+  Event& event_at(std::uint32_t index) const {
+    auto [segment, offset] = locate(index);
+    return segments_[segment].load(std::memory_order_acquire)[offset];
+  }
+
+  //
+  // Returns nullptr for ids this emitter never issued.
+  //
+  Event* find_event(EventId id) const {
+    if (id.index_ >= event_count_.load(std::memory_order_acquire)) {
+      return nullptr;
+    }
+    return &event_at(id.index_);
+  }
+
+  //
+  // For callers holding an epoch guard or mtx_.
+  //
+  Event* find_event(std::string_view name, std::uint64_t hash) const {
+    const NameIndex* index = index_.load();
+    if (index == nullptr) {
+      return nullptr;
+    }
+    for (std::size_t i = hash & index->mask;; i = (i + 1) & index->mask) {
+      Event* event = index->slots[i].load(std::memory_order_acquire);
+      if (event == nullptr) {
+        return nullptr;
+      }
+      if (event != NameIndex::RELEASED_SLOT && event->hash == hash && event->name == name) {
+        return event;
+      }
+    }
+  }
+
+  //
+  // Removes the listeners registered for this event by name and republishes
+  // its list. Listeners of patterns matching it stay. With `release`, for
+  // callers holding mtx_, the event is then released if it is left unused.
+  //
+  void clear_listeners(Event& event, bool release = false) {
+    Shard& shard = shard_of(event);
+    auto lock = acquire(shard.mtx, shard.counters);
+    if (const ListenerList* current = event.listeners.load()) {
+      for (Listener* listener : current->listeners) {
+        if (!listener->from_pattern) {
+          deactivate(shard, *listener);
+        }
+      }
+      republish(shard, event);
+    }
+    if (release) {
+      release_event(event);
+    }
+  }
+
+  //
+  // Lock-free, so an emit that fires a once listener can call it. Queues
+  // the event for the next writer that interns a name, which drops the
+  // fired and removed listeners from its list and releases it if nothing
+  // is left.
+  //
+  void schedule_compaction(Event& event) {
+    if (event.compacting.exchange(true, std::memory_order_acquire)) {
+      return;
+    }
+    Event* head = compactions_.load(std::memory_order_relaxed);
+    do {
+      event.next_compaction = head;
+    } while (!compactions_.compare_exchange_weak(head, &event, std::memory_order_release, std::memory_order_relaxed));
+  }
+
+  //
+  // With mtx_ held, so no slot is reused meanwhile.
+  //
+  void compact_scheduled() {
+    Event* event = compactions_.exchange(nullptr, std::memory_order_acquire);
+    while (event != nullptr) {
+      Event* next = event->next_compaction;
+      event->compacting.store(false, std::memory_order_release);  // Only after `next` is read.
+      if (!(event->holds.load(std::memory_order_relaxed) & RELEASED)) {
+        Shard& shard = shard_of(*event);
+        auto lock = acquire(shard.mtx, shard.counters);
+        const ListenerList* current = event->listeners.load();
+        if (current != nullptr && std::any_of(current->listeners.begin(), current->listeners.end(),
+                                              [](const Listener* listener) { return !listener->active.load(); })) {
+          republish(shard, *event);
+        }
+        release_event(*event);
+      }
+      event = next;
+    }
+  }
+
+  //
+  // With mtx_ and the event's shard locked. Unindexes an event with no
+  // listeners that nothing holds, and queues its slot for reuse. Listeners
+  // are only added under the shard lock after checking for RELEASED, so
+  // none is ever added to a released event.
+  //
+  void release_event(Event& event) {
+    std::uint32_t unused = 0;
+    if (event.listeners.load() != nullptr ||
+        !event.holds.compare_exchange_strong(unused, RELEASED, std::memory_order_acquire)) {
+      return;
+    }
+    index_.load()->erase(&event);
+    released_.push_back({event.index, epoch_.epoch()});
+  }
+
+  //
+  // Whether `name` is a pattern: some dot-separated segment is `*` or `**`.
+  //
+  static bool is_pattern(std::string_view name) {
+    for (std::size_t start = 0;;) {
+      std::size_t end = name.find('.', start);
+      std::string_view segment = name.substr(start, end - start);
+      if (segment == "*" || segment == "**") {
+        return true;
+      }
+      if (end == std::string_view::npos) {
+        return false;
+      }
+      start = end + 1;
+    }
+  }
+
+  //
+  // Matches segment by segment: `*` matches exactly one segment and `**`
+  // matches any number of them, including none. Only called when a pattern
+  // is registered or removed and when a name is first interned.
+  //
+  static bool matches(std::string_view pattern, std::string_view name) {
+    for (;;) {
+      std::size_t pattern_end = pattern.find('.');
+      std::string_view segment = pattern.substr(0, pattern_end);
+      if (segment == "**") {
+        if (pattern_end == std::string_view::npos) {
+          return true;
+        }
+        std::string_view rest = pattern.substr(pattern_end + 1);
+        for (;;) {
+          if (matches(rest, name)) {
+            return true;
+          }
+          std::size_t name_end = name.find('.');
+          if (name_end == std::string_view::npos) {
+            // Nothing left for `**` to consume; it may still match no segments.
+            return is_only_globstars(rest);
+          }
+          name = name.substr(name_end + 1);
+        }
+      }
+
+      std::size_t name_end = name.find('.');
+      if (segment != "*" && segment != name.substr(0, name_end)) {
+        return false;
+      }
+      if (pattern_end == std::string_view::npos) {
+        return name_end == std::string_view::npos;
+      }
+      if (name_end == std::string_view::npos) {
+        return is_only_globstars(pattern.substr(pattern_end + 1));
+      }
+      pattern = pattern.substr(pattern_end + 1);
+      name = name.substr(name_end + 1);
+    }
+  }
+
+  static bool is_only_globstars(std::string_view pattern) {
+    for (std::size_t start = 0;;) {
+      std::size_t end = pattern.find('.', start);
+      if (pattern.substr(start, end - start) != "**") {
+        return false;
+      }
+      if (end == std::string_view::npos) {
+        return true;
+      }
+      start = end + 1;
+    }
+  }
+
+  //
+  // With mtx_ held, for an event not yet indexed. Builds its first list from
+  // the active patterns it matches, by priority and then in the order they
+  // were registered.
+  //
+  ListenerList* match_patterns(const Event& event) {
+    if (pattern_count_.load(std::memory_order_relaxed) == 0) {
+      return nullptr;
+    }
+    ListenerList* list = nullptr;
+    for (const Pattern& pattern : patterns_) {
+      if (pattern.listener != nullptr && pattern.listener->active.load() && matches(pattern.text, event.name)) {
+        if (list == nullptr) {
+          list = allocator().new_object<ListenerList>(resource_);
+        }
+        list->push_back(pattern.listener);
+      }
+    }
+    if (list != nullptr) {
+      std::sort(list->listeners.begin(), list->listeners.end(), [&](const Listener* a, const Listener* b) {
+        if (a->priority != b->priority) {
+          return a->priority > b->priority;
+        }
+        return patterns_[a->slot].order < patterns_[b->slot].order;
+      });
+    }
+    return list;
+  }
+
+  //
+  // With mtx_ held. Registers a pattern and adds its listener to every event
+  // it already matches.
+  //
+  Subscription insert_pattern(std::string_view text, InlineFunction callback, const ListenerOptions& options) {
+    remove_fired_patterns();
+
+    Listener* listener = make_listener_node(std::move(callback), options);
+    listener->from_pattern = true;
+#if EVENTEMITTER_STATS
+    counters_.listeners_allocated.fetch_add(1, std::memory_order_relaxed);
+#endif
+
+    if (free_patterns_.empty()) {
+      listener->slot = std::uint32_t(patterns_.size());
+      patterns_.emplace_back(resource_);
+    } else {
+      listener->slot = free_patterns_.back();
+      free_patterns_.pop_back();
+    }
+    Pattern& pattern = patterns_[listener->slot];
+    pattern.text = text;
+    pattern.listener = listener;
+    pattern.order = next_pattern_order_++;
+    pattern_count_++;
+    pattern_listeners_++;
+    for (UnmatchedSet& set : unmatched_) {
+      for (auto& unmatched : set.hashes) {
+        unmatched.store(0, std::memory_order_relaxed);
+      }
+    }
+
+    for (std::uint32_t i = 0; i < event_count_.load(std::memory_order_relaxed); ++i) {
+      Event& event = event_at(i);
+      if (!(event.holds.load(std::memory_order_relaxed) & RELEASED) && matches(text, event.name)) {
+        Shard& shard = shard_of(event);
+        auto lock = acquire(shard.mtx, shard.counters);
+        republish(shard, event, listener);
+      }
+    }
+
+    return Subscription(this, PATTERN_TOKEN | listener->slot, pattern.generation);
+  }
+
+  //
+  // With mtx_ held. Takes the pattern's listener out of every list holding
+  // it and frees its slot. Returns false if it was a once listener that had
+  // already fired.
+  //
+  bool remove_pattern(std::uint32_t index) {
+    Pattern& pattern = patterns_[index];
+    Listener* listener = pattern.listener;
+    bool was_active = listener->active.exchange(false);
+    if (was_active) {
+      pattern_listeners_--;
+      unbind(*listener);
+    }
+
+    for (std::uint32_t i = 0; i < event_count_.load(std::memory_order_relaxed); ++i) {
+      Event& event = event_at(i);
+      if (!(event.holds.load(std::memory_order_relaxed) & RELEASED) && matches(pattern.text, event.name)) {
+        Shard& shard = shard_of(event);
+        auto lock = acquire(shard.mtx, shard.counters);
+        republish(shard, event);
+      }
+    }
+    epoch_.retire(retired_, listener);
+
+    pattern.listener = nullptr;
+    pattern.generation++;
+    free_patterns_.push_back(index);
+    pattern_count_--;
+    return was_active;
+  }
+
+  //
+  // With mtx_ held. Once pattern listeners that have fired stay registered
+  // until the next pattern change, which removes them here.
+  //
+  void remove_fired_patterns() {
+    for (std::uint32_t i = 0; i < patterns_.size(); ++i) {
+      if (patterns_[i].listener != nullptr && !patterns_[i].listener->active.load()) {
+        remove_pattern(i);
+      }
+    }
+  }
+
+  template <typename Callback>
+  Subscription add_pattern_listener(std::string_view text, Callback&& cb, bool is_once_flag, int priority,
+                                    std::shared_ptr<ExecutorBinding> binding = nullptr) {
+    using Arguments = typename traits<std::decay_t<Callback>>::ArgumentTypesAsTuple;
+    InlineFunction storable_func = to_inline_function(
+      std::forward<Callback>(cb), static_cast<Arguments*>(nullptr));
+
+    Subscription subscription;
+    {
+      auto lock = acquire(mtx_, counters_);
+      subscription = insert_pattern(text, std::move(storable_func), {is_once_flag, callback_result<Callback>, priority, std::move(binding)});
+    }
+    check_listener_limit(text);
+    return subscription;
+  }
+
+  //
+  // With mtx_ held.
+  //
+  bool matches_any_pattern(std::string_view name) const {
+    for (const Pattern& pattern : patterns_) {
+      if (pattern.listener != nullptr && pattern.listener->active.load() && matches(pattern.text, name)) {
+        return true;
+      }
+    }
+    return false;
+  }
+
+  //
+  // For callers holding an epoch guard. A name emitted for the first time
+  // that some pattern matches is interned, so the patterns it matches are
+  // resolved once and kept in its listener list. Names no pattern matches
+  // are not interned, so emitting ever-new names costs no memory; they are
+  // remembered in unmatched_ instead.
+  //
+  Event* resolve(std::string_view name, std::uint64_t hash) {
+    if (Event* event = find_event(name, hash)) {
+      return event;
+    }
+    if (pattern_count_.load() == 0) {
+      return nullptr;
+    }
+    UnmatchedSet& set = unmatched_[mix_hash(hash) & (UNMATCHED_SETS - 1)];
+    if (hash != 0) {
+      for (auto& unmatched : set.hashes) {
+        if (unmatched.load(std::memory_order_relaxed) == hash) {
+          return nullptr;
+        }
+      }
+    }
+    {
+      auto lock = acquire(mtx_, counters_);
+      if (!matches_any_pattern(name)) {
+        remember_unmatched(set, hash);
+        return nullptr;
+      }
+    }
+    return &intern(name, hash);
+  }
+
+  //
+  // With mtx_ held. Takes a free entry of the set, or else evicts one in
+  // turn.
+  //
+  void remember_unmatched(UnmatchedSet& set, std::uint64_t hash) {
+    for (auto& unmatched : set.hashes) {
+      std::uint64_t current = unmatched.load(std::memory_order_relaxed);
+      if (current == hash) {
+        return;
+      }
+      if (current == 0) {
+        unmatched.store(hash, std::memory_order_relaxed);
+        return;
+      }
+    }
+    set.hashes[unmatched_victim_++ % UNMATCHED_WAYS].store(hash, std::memory_order_relaxed);
+  }
+
+public:
+  int maxListeners = 10;
+
+  EventEmitter() : EventEmitter(std::pmr::get_default_resource()) {}
+
+  //
+  // Allocates listener nodes, listener lists, heap-stored callbacks, event
+  // names and bookkeeping from `resource`, which must outlive the emitter
+  // and be thread-safe if the emitter is used from several threads. Once
+  // every event has been registered, emit() allocates nothing.
+  //
+  explicit EventEmitter(std::pmr::memory_resource* resource)
+    : resource_(resource),
+      shards_(make_shards(resource, std::make_index_sequence<SHARDS>())) {}
+
+  ~EventEmitter() {
+    delete async_.load();
+    for (std::uint32_t i = 0; i < event_count_.load(); ++i) {
+      if (const ListenerList* list = event_at(i).listeners.load()) {
+        for (Listener* listener : list->listeners) {
+          if (listener->active.load()) {
+            unbind(*listener);
+          }
+          if (!listener->from_pattern) {
+            allocator().delete_object(listener);
+          }
+        }
+        allocator().delete_object(const_cast<ListenerList*>(list));
+      }
+    }
+    for (const Pattern& pattern : patterns_) {
+      if (pattern.listener != nullptr) {
+        if (pattern.listener->active.load()) {
+          unbind(*pattern.listener);
+        }
+        allocator().delete_object(pattern.listener);
+      }
+    }
+    for (std::size_t segment = 0; segment < MAX_SEGMENTS; ++segment) {
+      if (Event* events = segments_[segment].load()) {
+        std::destroy_n(events, segment_size(segment));
+        allocator().deallocate_object(events, segment_size(segment));
+      }
+    }
+    if (const NameIndex* index = index_.load()) {
+      allocator().delete_object(const_cast<NameIndex*>(index));
+    }
+  }
+
+  EventEmitter(const EventEmitter&) = delete;
+  EventEmitter& operator=(const EventEmitter&) = delete;
+  EventEmitter(EventEmitter&&) = delete;
+  EventEmitter& operator=(EventEmitter&&) = delete;
+
+
+  //
+  // Sums the per-shard counts, so it is exact when no other thread is
+  // adding or removing listeners.
+  //
+  int listeners() const {
+    return listener_count();
+  }
+
+  //
+  // Replaces what happens when a registration takes the listener count past
+  // maxListeners. The handler runs on the registering thread with no lock
+  // held. The default, restored by passing nullptr, prints a warning to
+  // std::cout; pass a handler that does nothing to silence it.
+  //
+  void setLeakWarningHandler(LeakWarningHandler handler) {
+    auto lock = acquire(mtx_, counters_);
+    leak_warning_handler_ = std::move(handler);
+  }
+
+  //
+  // Hands every emit to `tap` from now on, or to nothing if it is null.
+  // When it returns, no emit is still using the previous tap. Must not be
+  // called from a listener.
+  //
+  void record(EmitTap* tap) {
+    tap_.store(tap, std::memory_order_release);
+    epoch_.synchronize();
+  }
+
+  //
+  // Counters and histograms collected since the emitter was created, or an
+  // empty Stats unless EVENTEMITTER_STATS is 1. Each counter is read
+  // atomically, but not all of them at the same instant.
+  //
+  Stats stats() {
+    Stats result;
+#if EVENTEMITTER_STATS
+    auto add_counters = [&](const WriterCounters& counters) {
+      result.lock_waits += counters.lock_waits.load(std::memory_order_relaxed);
+      result.lock_wait_ns += counters.lock_wait_ns.load(std::memory_order_relaxed);
+      result.snapshots_published += counters.snapshots_published.load(std::memory_order_relaxed);
+      result.listeners_allocated += counters.listeners_allocated.load(std::memory_order_relaxed);
+    };
+    add_counters(counters_);
+    for (const Shard& shard : shards_) {
+      add_counters(shard.counters);
+    }
+
+    EpochDomain::Guard guard(epoch_);
+    auto lock = acquire(mtx_, counters_);  // Keeps released events from being reused meanwhile.
+    std::uint32_t count = event_count_.load(std::memory_order_relaxed);
+    result.events.reserve(count);
+    for (std::uint32_t i = 0; i < count; ++i) {
+      const Event& event = event_at(i);
+      if (event.holds.load(std::memory_order_relaxed) & RELEASED) {
+        continue;
+      }
+      EventStats& event_stats = result.events.emplace_back();
+      event_stats.name = std::string(event.name);
+      event_stats.shard = shard_index(event.hash);
+      event_stats.emits = event.emits.load(std::memory_order_relaxed);
+      if (const ListenerList* snapshot = event.listeners.load()) {
+        for (const Listener* listener : snapshot->listeners) {
+          if (listener->active.load(std::memory_order_relaxed)) {
+            event_stats.listeners.push_back({listener->is_once, listener->call_ns.snapshot()});
+          }
+        }
+      }
+    }
+#endif
+    return result;
+  }
+
+  //
+  // Interns `name` and returns a handle that skips the name lookup in every
+  // other call. Calling it again with the same name returns the same id.
+  // The event is pinned: it is never released.
+  //
+  EventId id(std::string_view name) {
+    return id(EventName(name));
+  }
+
+  EventId id(const EventName& name) {
+    EventHold held = intern_held(name.name, name.hash);
+    held.get()->holds.fetch_or(PINNED, std::memory_order_relaxed);
+    return EventId(held.get()->index);
+  }
+
+  //
+  // Listeners run in order of `priority`, highest first, and in
+  // registration order within a priority. The order is fixed when a
+  // listener is added, not on each emit. A listener returning
+  // Propagation::Stop ends the emit: the listeners after it are not called.
+  //
+  template <typename Callback>
+  Subscription on(std::string_view name, Callback&& cb, int priority = 0) {
+    return on(EventName(name), std::forward<Callback>(cb), priority);
+  }
+
+  //
+  // A name with a `*` or `**` segment, e.g. "order.*" or "order.**",
+  // subscribes to every event whose name matches it. See is_pattern and
+  // matches.
+  //
+  template <typename Callback>
+  Subscription on(const EventName& name, Callback&& cb, int priority = 0) {
+    if (is_pattern(name.name)) {
+      return add_pattern_listener(name.name, std::forward<Callback>(cb), false /*is_once_flag*/, priority);
+    }
+    return add_listener(name, std::forward<Callback>(cb), false /*is_once_flag*/, priority);
+  }
+
+  //
+  // Returns an empty Subscription for ids this emitter never issued.
+  //
+  template <typename Callback>
+  Subscription on(EventId id, Callback&& cb, int priority = 0) {
+    Event* event = find_event(id);
+    if (event == nullptr) {
+      return Subscription();
+    }
+    return add_listener(*event, std::forward<Callback>(cb), false /*is_once_flag*/, priority);
+  }
+
+  template <typename Callback>
+  Subscription once(std::string_view name, Callback&& cb, int priority = 0) {
+    return once(EventName(name), std::forward<Callback>(cb), priority);
+  }
+
+  //
+  // A once listener on a pattern fires for the first matching emit only.
+  //
+  template <typename Callback>
+  Subscription once(const EventName& name, Callback&& cb, int priority = 0) {
+    if (is_pattern(name.name)) {
+      return add_pattern_listener(name.name, std::forward<Callback>(cb), true /*is_once_flag*/, priority);
+    }
+    return add_listener(name, std::forward<Callback>(cb), true /*is_once_flag*/, priority);
+  }
+
+  template <typename Callback>
+  Subscription once(EventId id, Callback&& cb, int priority = 0) {
+    Event* event = find_event(id);
+    if (event == nullptr) {
+      return Subscription();
+    }
+    return add_listener(*event, std::forward<Callback>(cb), true /*is_once_flag*/, priority);
+  }
+
+  //
+  // Calls `cb` on the thread that polls `executor` instead of the emitting
+  // one. Emit copies the arguments into the executor's inbox and returns
+  // without waiting. Priorities order the deliveries of one emit, but a
+  // returned Propagation::Stop cannot stop an emit that has already
+  // returned, so it is ignored; a returned Task is started by poll().
+  // Deliveries still queued when the listener is removed are dropped.
+  //
+  template <typename Callback>
+  Subscription on(std::string_view name, Callback&& cb, Executor& executor, int priority = 0) {
+    return on(EventName(name), std::forward<Callback>(cb), executor, priority);
+  }
+
+  template <typename Callback>
+  Subscription on(const EventName& name, Callback&& cb, Executor& executor, int priority = 0) {
+    auto [deliver, binding] = bind_to_executor(std::forward<Callback>(cb), executor);
+    if (is_pattern(name.name)) {
+      return add_pattern_listener(name.name, std::move(deliver), false /*is_once_flag*/, priority, std::move(binding));
+    }
+    return add_listener(name, std::move(deliver), false /*is_once_flag*/, priority, std::move(binding));
+  }
+
+  template <typename Callback>
+  Subscription on(EventId id, Callback&& cb, Executor& executor, int priority = 0) {
+    Event* event = find_event(id);
+    if (event == nullptr) {
+      return Subscription();
+    }
+    auto [deliver, binding] = bind_to_executor(std::forward<Callback>(cb), executor);
+    return add_listener(*event, std::move(deliver), false /*is_once_flag*/, priority, std::move(binding));
+  }
+
+  template <typename Callback>
+  Subscription once(std::string_view name, Callback&& cb, Executor& executor, int priority = 0) {
+    return once(EventName(name), std::forward<Callback>(cb), executor, priority);
+  }
+
+  template <typename Callback>
+  Subscription once(const EventName& name, Callback&& cb, Executor& executor, int priority = 0) {
+    auto [deliver, binding] = bind_to_executor(std::forward<Callback>(cb), executor);
+    if (is_pattern(name.name)) {
+      return add_pattern_listener(name.name, std::move(deliver), true /*is_once_flag*/, priority, std::move(binding));
+    }
+    return add_listener(name, std::move(deliver), true /*is_once_flag*/, priority, std::move(binding));
+  }
+
+  template <typename Callback>
+  Subscription once(EventId id, Callback&& cb, Executor& executor, int priority = 0) {
+    Event* event = find_event(id);
+    if (event == nullptr) {
+      return Subscription();
+    }
+    auto [deliver, binding] = bind_to_executor(std::forward<Callback>(cb), executor);
+    return add_listener(*event, std::move(deliver), true /*is_once_flag*/, priority, std::move(binding));
+  }
+
+  //
+  // Removes the patterns first, then clears one event at a time, taking each
+  // event's shard lock in turn.
+  //
+  void off() {
+    {
+      auto lock = acquire(mtx_, counters_);
+      for (std::uint32_t i = 0; i < patterns_.size(); ++i) {
+        if (patterns_[i].listener != nullptr) {
+          remove_pattern(i);
+        }
+      }
+    }
+    for (std::uint32_t i = 0; i < event_count_.load(std::memory_order_acquire); ++i) {
+      clear_listeners(event_at(i));
+    }
+  }
+
+  void off(std::string_view name) {
+    off(EventName(name));
+  }
+
+  //
+  // Removes the listeners registered with exactly this name or pattern.
+  // `off("order.fill")` leaves "order.*" listeners in place, and
+  // `off("order.*")` does not touch "order.**" or "order.fill" listeners.
+  // An event left with no listeners is released, so names used once and
+  // then removed do not accumulate, unless an EventId pins it or a queued
+  // emit or waiting coroutine still holds it.
+  //
+  void off(const EventName& name) {
+    if (is_pattern(name.name)) {
+      auto lock = acquire(mtx_, counters_);
+      for (std::uint32_t i = 0; i < patterns_.size(); ++i) {
+        if (patterns_[i].listener != nullptr && patterns_[i].text == name.name) {
+          remove_pattern(i);
+        }
+      }
+      return;
+    }
+    auto lock = acquire(mtx_, counters_);
+    if (Event* event = find_event(name.name, name.hash)) {
+      clear_listeners(*event, true /*release*/);
+    }
+  }
+
+  void off(EventId id) {
+    if (Event* event = find_event(id)) {
+      clear_listeners(*event);
+    }
+  }
+
+  template <typename... EmitArgs>
+  void emit(std::string_view name, EmitArgs&&... args) {
+    emit(EventName(name), std::forward<EmitArgs>(args)...);
+  }
+
+  template <typename... EmitArgs>
+  void emit(const EventName& name, EmitArgs&&... args) {
+    EpochDomain::Guard guard(epoch_);
+    if (EmitTap* tap = tap_.load(std::memory_order_acquire)) {
+      tap_emit<std::decay_t<EmitArgs>...>(*tap, name.name, args...);
+    }
+    if (Event* event = resolve(name.name, name.hash)) {
+      dispatch(*event, std::forward<EmitArgs>(args)...);
+    }
+  }
+
+  template <typename... EmitArgs>
+  void emit(EventId id, EmitArgs&&... args) {
+    EpochDomain::Guard guard(epoch_);
+    if (Event* event = find_event(id)) {
+      if (EmitTap* tap = tap_.load(std::memory_order_acquire)) {
+        tap_emit<std::decay_t<EmitArgs>...>(*tap, event->name, args...);
+      }
+      dispatch(*event, std::forward<EmitArgs>(args)...);
+    }
+  }
+
+  //
+  // Delivers every item in `items` (any contiguous range, e.g. a
+  // std::vector or std::span) with a single lookup and listener pass.
+  // Listeners taking `std::span<const T>` receive the whole batch in one
+  // call; listeners taking `const T&` are called once per item.
+  //
+  template <typename Items>
+  void emitBatch(std::string_view name, const Items& items) {
+    emitBatch(EventName(name), items);
+  }
+
+  template <typename Items>
+  void emitBatch(const EventName& name, const Items& items) {
+    EpochDomain::Guard guard(epoch_);
+    if (Event* event = resolve(name.name, name.hash)) {
+      dispatch_batch(*event, as_const_span(items));
+    }
+  }
+
+  template <typename Items>
+  void emitBatch(EventId id, const Items& items) {
+    EpochDomain::Guard guard(epoch_);
+    if (Event* event = find_event(id)) {
+      dispatch_batch(*event, as_const_span(items));
+    }
+  }
+
+  //
+  // Starts (or restarts) the dispatcher threads used by emitAsync. Calling it
+  // is optional; the first emitAsync starts one thread with the default
+  // options. Restarting dispatches everything already queued first, and must
+  // not race with emitAsync.
+  //
+  void configureAsync(const AsyncOptions& options) {
+    auto next = new AsyncDispatcher(options);
+    AsyncDispatcher* previous;
+    {
+      auto lock = acquire(mtx_, counters_);
+      previous = async_.exchange(next);
+    }
+    delete previous;
+  }
+
+  //
+  // Queues the event for a dispatcher thread instead of calling the
+  // listeners here. Arguments are copied (or moved) into the queue. Events
+  // with the same name are dispatched in the order they were queued, to the
+  // listeners registered at the time of dispatch. Returns false only if the
+  // Backpressure::Fail policy rejected the event.
+  //
+  template <typename... EmitArgs>
+  bool emitAsync(std::string_view name, EmitArgs&&... args) {
+    return emitAsync(EventName(name), std::forward<EmitArgs>(args)...);
+  }
+
+  template <typename... EmitArgs>
+  bool emitAsync(const EventName& name, EmitArgs&&... args) {
+    EventHold held;
+    {
+      EpochDomain::Guard guard(epoch_);
+      if (EmitTap* tap = tap_.load(std::memory_order_acquire)) {
+        tap_emit<std::decay_t<EmitArgs>...>(*tap, name.name, args...);
+      }
+      // A released event had no listeners, so there is nothing to queue.
+      Event* event = resolve(name.name, name.hash);
+      if (event != nullptr && hold(*event)) {
+        held = EventHold(this, event);
+      }
+    }
+    return held.get() ? post(std::move(held), std::forward<EmitArgs>(args)...) : true;
+  }
+
+  template <typename... EmitArgs>
+  bool emitAsync(EventId id, EmitArgs&&... args) {
+    Event* event = find_event(id);
+    if (event != nullptr && tap_.load(std::memory_order_relaxed) != nullptr) {
+      EpochDomain::Guard guard(epoch_);
+      if (EmitTap* tap = tap_.load(std::memory_order_acquire)) {
+        tap_emit<std::decay_t<EmitArgs>...>(*tap, event->name, args...);
+      }
+    }
+    return event && hold(*event) ? post(EventHold(this, event), std::forward<EmitArgs>(args)...) : true;
+  }
 
-  template <typename Callable>
-  struct traits : public traits<decltype(&std::decay_t<Callable>::operator())> {};
+  //
+  // Waits until everything queued by emitAsync before the call has been
+  // dispatched (or dropped). Must not be called from a listener running on
+  // a dispatcher thread.
+  //
+  void drain() {
+    if (AsyncDispatcher* dispatcher = async_.load()) {
+      dispatcher->drain();
+    }
+  }
 
-  template <typename ClassType, typename R, typename... Args>
-  struct traits<R(ClassType::*)(Args...) const> {
-    using ReturnType = R; using ArgumentTypesAsTuple = std::tuple<Args...>;
-    using OriginalFunctionType = std::function<R(Args...)>;
-    using StoredFunctionType = std::function<void(std::decay_t<Args>...)>;
-  };
-  template <typename ClassType, typename R, typename... Args>
-  struct traits<R(ClassType::*)(Args...) const noexcept> {
-    using ReturnType = R; using ArgumentTypesAsTuple = std::tuple<Args...>;
-    using OriginalFunctionType = std::function<R(Args...)>;
-    using StoredFunctionType = std::function<void(std::decay_t<Args>...)>;
-  };
-  template <typename ClassType, typename R, typename... Args>
-  struct traits<R(ClassType::*)(Args...) > {
-    using ReturnType = R; using ArgumentTypesAsTuple = std::tuple<Args...>;
-    using OriginalFunctionType = std::function<R(Args...)>;
-    using StoredFunctionType = std::function<void(std::decay_t<Args>...)>;
-  };
-  template <typename ClassType, typename R, typename... Args>
-  struct traits<R(ClassType::*)(Args...) noexcept> {
-    using ReturnType = R; using ArgumentTypesAsTuple = std::tuple<Args...>;
-    using OriginalFunctionType = std::function<R(Args...)>;
-    using StoredFunctionType = std::function<void(std::decay_t<Args>...)>;
+  //
+  // Returned by next(). Suspends the awaiting coroutine until the event is
+  // emitted with arguments matching `Args`, then resumes it inside that
+  // emit, on the emitting thread, after the listeners. The waiter lives in
+  // the coroutine frame, so waiting allocates nothing; a coroutine
+  // suspended here must not be destroyed before it is resumed.
+  //
+  template <typename... Args>
+  class NextEvent : private Waiter {
+    friend class EventEmitter;
+    using Values = std::tuple<std::decay_t<Args>...>;
+
+    EventHold event_;
+    std::coroutine_handle<> handle_;
+    std::optional<Values> values_;
+
+    explicit NextEvent(EventHold event) : event_(std::move(event)) {}
+
+    static void take(Waiter& waiter, const void* arguments) {
+      auto& self = static_cast<NextEvent&>(waiter);
+      self.values_.emplace(*static_cast<const std::tuple<const std::decay_t<Args>&...>*>(arguments));
+      self.handle_.resume();
+    }
+
+  public:
+    bool await_ready() const noexcept { return false; }
+
+    void await_suspend(std::coroutine_handle<> handle) {
+      handle_ = handle;
+      this->signature = &signature_tag<const std::decay_t<Args>&...>;
+      this->resume = &take;
+      push_waiter(*event_.get(), *this);  // Last: an emit may resume the coroutine right away.
+    }
+
+    //
+    // Nothing for an event without arguments, the value for one argument,
+    // and a tuple otherwise.
+    //
+    auto await_resume() {
+      if constexpr (sizeof...(Args) == 0) {
+        return;
+      } else if constexpr (sizeof...(Args) == 1) {
+        return std::get<0>(std::move(*values_));
+      } else {
+        return std::move(*values_);
+      }
+    }
   };
-  template <typename R, typename... Args>
-  struct traits<R(*)(Args...)> {
-    using ReturnType = R; using ArgumentTypesAsTuple = std::tuple<Args...>;
-    using OriginalFunctionType = std::function<R(Args...)>;
-    using StoredFunctionType = std::function<void(std::decay_t<Args>...)>;
+
+  //
+  // `int code = co_await ee.next<int>("ready");` Takes an event name, not
+  // a pattern.
+  //
+  template <typename... Args>
+  NextEvent<Args...> next(std::string_view name) {
+    return next<Args...>(EventName(name));
+  }
+
+  template <typename... Args>
+  NextEvent<Args...> next(const EventName& name) {
+    return NextEvent<Args...>(intern_held(name.name, name.hash));
+  }
+
+  //
+  // Returned by emitAwait(). Queues the emit for a dispatcher thread when
+  // awaited, and resumes the awaiting coroutine once the listeners have run
+  // and every coroutine listener they started has finished. The arguments
+  // stay in the awaiting frame and the queued task only points at them.
+  // Resumes with false if the backpressure policy rejected or dropped the
+  // emit.
+  //
+  template <typename... Args>
+  class AwaitedEmit {
+    friend class EventEmitter;
+
+    //
+    // The queued task. If it is dropped without running, the await ends
+    // with false.
+    //
+    struct Dispatch {
+      mutable AwaitedEmit* awaited;
+
+      explicit Dispatch(AwaitedEmit* awaited) : awaited(awaited) {}
+      Dispatch(Dispatch&& other) noexcept : awaited(std::exchange(other.awaited, nullptr)) {}
+
+      ~Dispatch() {
+        if (awaited != nullptr) {
+          awaited->dispatched_ = false;
+          awaited->completion_.release();
+        }
+      }
+
+      void operator()() const {
+        AwaitedEmit* self = std::exchange(awaited, nullptr);
+        {
+          EpochDomain::Guard guard(self->emitter_->epoch_);
+          std::apply([&](const auto&... args) {
+            self->emitter_->dispatch_awaited(&self->completion_, *self->event_.get(), args...);
+          }, self->arguments_);
+        }
+        self->completion_.release();  // May resume and end the awaiting coroutine.
+      }
+    };
+
+    EventEmitter* emitter_;
+    EventHold event_;
+    std::tuple<Args...> arguments_;
+    Completion completion_;
+    bool dispatched_ = true;
+
+    template <typename... EmitArgs>
+    AwaitedEmit(EventEmitter* emitter, EventHold event, EmitArgs&&... args)
+      : emitter_(emitter), event_(std::move(event)), arguments_(std::forward<EmitArgs>(args)...) {}
+
+  public:
+    bool await_ready() const noexcept { return event_.get() == nullptr; }
+
+    //
+    // One reference for the queued task and one for this call, so the
+    // coroutine neither resumes before it has suspended nor suspends after
+    // everything has finished.
+    //
+    bool await_suspend(std::coroutine_handle<> handle) {
+      completion_.awaiting = handle;
+      completion_.pending.store(2, std::memory_order_relaxed);
+      InlineFunction task = InlineFunction::create<>(Dispatch(this), emitter_->resource_);
+      emitter_->async_dispatcher().push(event_.get()->index, task);
+      task = InlineFunction();  // A rejected task releases its reference here.
+      return completion_.pending.fetch_sub(1, std::memory_order_acq_rel) != 1;
+    }
+
+    bool await_resume() const noexcept { return dispatched_; }
   };
-  template <typename R, typename... Args>
-  struct traits<R(*)(Args...) noexcept> {
-    using ReturnType = R; using ArgumentTypesAsTuple = std::tuple<Args...>;
-    using OriginalFunctionType = std::function<R(Args...)>;
-    using StoredFunctionType = std::function<void(std::decay_t<Args>...)>;
+
+  //
+  // Like emitAsync, but awaitable: `bool ok = co_await ee.emitAwait("job", 7);`
+  // resumes once every listener of the emit, including coroutine listeners,
+  // has finished.
+  //
+  template <typename... EmitArgs>
+  AwaitedEmit<std::decay_t<EmitArgs>...> emitAwait(std::string_view name, EmitArgs&&... args) {
+    return emitAwait(EventName(name), std::forward<EmitArgs>(args)...);
+  }
+
+  template <typename... EmitArgs>
+  AwaitedEmit<std::decay_t<EmitArgs>...> emitAwait(const EventName& name, EmitArgs&&... args) {
+    EventHold held;
+    {
+      EpochDomain::Guard guard(epoch_);
+      Event* event = resolve(name.name, name.hash);
+      if (event != nullptr && hold(*event)) {
+        held = EventHold(this, event);
+      }
+    }
+    return AwaitedEmit<std::decay_t<EmitArgs>...>(this, std::move(held), std::forward<EmitArgs>(args)...);
+  }
+
+  template <typename... EmitArgs>
+  AwaitedEmit<std::decay_t<EmitArgs>...> emitAwait(EventId id, EmitArgs&&... args) {
+    Event* event = find_event(id);
+    EventHold held(this, event != nullptr && hold(*event) ? event : nullptr);
+    return AwaitedEmit<std::decay_t<EmitArgs>...>(this, std::move(held), std::forward<EmitArgs>(args)...);
+  }
+
+private:
+  template <typename T>
+  static constexpr std::string_view type_name() {
+#if defined(__GNUC__) || defined(__clang__)
+    return __PRETTY_FUNCTION__;
+#else
+    return __FUNCSIG__;
+#endif
+  }
+
+  //
+  // Identifies an argument list across processes and runs. Built from the
+  // compiler's spelling of the types, so it only matches between programs
+  // built with the same compiler.
+  //
+  template <typename... Args>
+  static constexpr std::uint64_t fingerprint = hash_name(type_name<std::tuple<Args...>>());
+
+  template <typename T>
+  static constexpr bool has_serializer = requires(const T& value, std::byte* out) {
+    EventSerializer<T>::write(value, out);
   };
-  template <typename R, typename... Args>
-  struct traits<std::function<R(Args...)>> {
-    using ReturnType = R; using ArgumentTypesAsTuple = std::tuple<Args...>;
-    using OriginalFunctionType = std::function<R(Args...)>;
-    using StoredFunctionType = std::function<void(std::decay_t<Args>...)>;
+
+  template <typename T>
+  static constexpr bool is_recordable = has_serializer<T> ||
+    (std::is_trivially_copyable_v<T> && !std::is_pointer_v<T> && !std::is_member_pointer_v<T>);
+
+  //
+  // How a tap stores the arguments of one signature, and how EventReplay
+  // emits them again. Trivially copyable arguments are stored byte for
+  // byte, others as a 32-bit length and what their EventSerializer writes.
+  //
+  template <typename... Args>
+  struct ArgumentCodec {
+    using Arguments = std::tuple<const Args&...>;
+
+    template <typename T>
+    static std::size_t size_of(const T& value) {
+      if constexpr (has_serializer<T>) {
+        return sizeof(std::uint32_t) + EventSerializer<T>::size(value);
+      } else {
+        return sizeof(T);
+      }
+    }
+
+    template <typename T>
+    static std::byte* write_one(const T& value, std::byte* out) {
+      if constexpr (has_serializer<T>) {
+        auto size = std::uint32_t(EventSerializer<T>::size(value));
+        std::memcpy(out, &size, sizeof(size));
+        EventSerializer<T>::write(value, out + sizeof(size));
+        return out + sizeof(size) + size;
+      } else {
+        std::memcpy(out, &value, sizeof(T));
+        return out + sizeof(T);
+      }
+    }
+
+    // Whether a T is stored in the `left` bytes at `in`, and steps past it.
+    template <typename T>
+    static bool fits_one(const std::byte*& in, std::size_t& left) {
+      std::size_t size = sizeof(T);
+      if constexpr (has_serializer<T>) {
+        if (left < sizeof(std::uint32_t)) {
+          return false;
+        }
+        std::uint32_t length;
+        std::memcpy(&length, in, sizeof(length));
+        size = sizeof(length) + std::size_t(length);
+      }
+      if (left < size) {
+        return false;
+      }
+      in += size;
+      left -= size;
+      return true;
+    }
+
+    template <typename T>
+    static T read_one(const std::byte*& in) {
+      if constexpr (has_serializer<T>) {
+        std::uint32_t size;
+        std::memcpy(&size, in, sizeof(size));
+        const std::byte* data = in + sizeof(size);
+        in = data + size;
+        return EventSerializer<T>::read(data, size);
+      } else {
+        std::array<std::byte, sizeof(T)> bytes;
+        std::memcpy(bytes.data(), in, sizeof(T));
+        in += sizeof(T);
+        return std::bit_cast<T>(bytes);
+      }
+    }
+
+    static std::size_t size(const void* arguments) {
+      return std::apply([](const Args&... args) {
+        return (std::size_t(0) + ... + size_of(args));
+      }, *static_cast<const Arguments*>(arguments));
+    }
+
+    static void write(const void* arguments, std::byte* out) {
+      std::apply([&](const Args&... args) {
+        ((out = write_one(args, out)), ...);
+      }, *static_cast<const Arguments*>(arguments));
+    }
+
+    static bool replay(EventEmitter& emitter, std::string_view name, const std::byte* in, std::size_t size) {
+      [[maybe_unused]] const std::byte* cursor = in;
+      if (!((fits_one<Args>(cursor, size) && ...) && size == 0)) {
+        return false;
+      }
+      std::tuple<Args...> values{read_one<Args>(in)...};  // Braces read the arguments in order.
+      std::apply([&](const Args&... args) {
+        emitter.emit(name, args...);
+      }, values);
+      return true;
+    }
+
+    static EmitPayload payload(const Arguments& arguments) {
+      if constexpr ((is_recordable<Args> && ...)) {
+        return {fingerprint<Args...>, &size, &write, &replay, &arguments};
+      } else {
+        return {0, nullptr, nullptr, nullptr, &arguments};
+      }
+    }
   };
 
-  template <typename Callback>
-  static typename traits<std::decay_t<Callback>>::OriginalFunctionType
-  to_original_function(Callback&& cb) {
-    return typename traits<std::decay_t<Callback>>::OriginalFunctionType(std::forward<Callback>(cb));
+  //
+  // With an epoch guard held, so record() can wait for taps in progress.
+  //
+  template <typename... Args>
+  static void tap_emit(EmitTap& tap, std::string_view name, const Args&... args) {
+    const std::tuple<const Args&...> arguments(args...);
+    tap.tap(name, ArgumentCodec<Args...>::payload(arguments));
   }
 
-  template <typename Callback>
-  void add_listener(const std::string& name, Callback&& cb, bool is_once_flag) {
-    std::lock_guard<std::mutex> lock(mtx_);
+  template <typename Items>
+  static auto as_const_span(const Items& items) {
+    using Element = std::remove_const_t<typename decltype(std::span(items))::element_type>;
+    return std::span<const Element>(items);
+  }
 
-    if (++this->_listeners > this->maxListeners) {
-      std::cout
-        << "warning: possible EventEmitter memory leak detected. "
-        << this->_listeners
-        << " listeners added (max is " << this->maxListeners
-        << "). For event: " << name
-        << std::endl;
+  std::pmr::polymorphic_allocator<> allocator() const {
+    return std::pmr::polymorphic_allocator<>(resource_);
+  }
+
+  AsyncDispatcher& async_dispatcher() {
+    if (AsyncDispatcher* dispatcher = async_.load(std::memory_order_acquire)) {
+      return *dispatcher;
+    }
+    auto lock = acquire(mtx_, counters_);
+    if (async_.load() == nullptr) {
+      async_.store(new AsyncDispatcher(AsyncOptions{}));
     }
+    return *async_.load();
+  }
 
-    auto original_func = to_original_function(std::forward<Callback>(cb));
-    typename traits<std::decay_t<Callback>>::StoredFunctionType storable_func = original_func;
+  //
+  // The task keeps its hold on the event until it has run or been dropped.
+  //
+  template <typename... EmitArgs>
+  bool post(EventHold held, EmitArgs&&... args) {
+    std::uint32_t index = held.get()->index;
+    InlineFunction task = InlineFunction::create<>(
+      [this, held = std::move(held), captured = std::tuple<std::decay_t<EmitArgs>...>(std::forward<EmitArgs>(args)...)]() {
+        EpochDomain::Guard guard(epoch_);
+        std::apply([&](const auto&... captured_args) {
+          dispatch(*held.get(), captured_args...);
+        }, captured);
+      }, resource_);
+    return async_dispatcher().push(index, task);
+  }
 
-    events[name].push_back({storable_func, is_once_flag});
+  //
+  // Readers only, with an epoch guard held.
+  //
+  template <typename... EmitArgs>
+  void dispatch(Event& event, EmitArgs&&... args) {
+    dispatch_awaited(nullptr, event, std::forward<EmitArgs>(args)...);
   }
 
-public:
-  int maxListeners = 10;
+  //
+  // Readers only, with an epoch guard held. `completion`, if given, also
+  // waits for the coroutine listeners started here. Waiters in next() are
+  // resumed after the listeners, unless one of them stopped the emit.
+  //
+  template <typename... EmitArgs>
+  void dispatch_awaited(Completion* completion, Event& event, EmitArgs&&... args) {
+    count_emits(event);
+    if (const ListenerList* snapshot = event.listeners.load()) {
+      bool stopped = snapshot->has_results
+        ? call_listeners<true, std::decay_t<EmitArgs>...>(completion, event, *snapshot, args...)
+        : call_listeners<false, std::decay_t<EmitArgs>...>(completion, event, *snapshot, args...);
+      if (stopped) {
+        return;
+      }
+    }
+    if (event.waiters.load(std::memory_order_acquire) != nullptr) {
+      resume_waiters<std::decay_t<EmitArgs>...>(event, args...);
+    }
+  }
 
-  EventEmitter() = default;
-  ~EventEmitter() = default;
+  //
+  // `Results` is only true for lists holding a listener that returns
+  // Propagation or Task, so lists of void listeners never check results.
+  // Returns true if a listener stopped the emit.
+  //
+  template <bool Results, typename... EmitArgs>
+  bool call_listeners(Completion* completion, Event& event, const ListenerList& snapshot, const EmitArgs&... args) {
+    const void* signature = &signature_tag<const EmitArgs&...>;
+    bool checked = snapshot.signature == signature;
 
-  EventEmitter(const EventEmitter&) = delete;
-  EventEmitter& operator=(const EventEmitter&) = delete;
-  EventEmitter(EventEmitter&&) = delete;
-  EventEmitter& operator=(EventEmitter&&) = delete;
+    for (Listener* listener_entry : snapshot.listeners) {
+      if (!listener_entry->active.load(std::memory_order_relaxed)) {
+        continue;
+      }
+      if (!checked && listener_entry->callback.signature() != signature) {
+        if constexpr (sizeof...(EmitArgs) == 1) {
+          // A batch listener sees a single emit as a batch of one.
+          using Item = std::tuple_element_t<0, std::tuple<EmitArgs...>>;
+          if (listener_entry->callback.signature() == batch_signature<Item>()) {
+            if (claim(event, *listener_entry)) {
+              const Item& item = std::get<0>(std::forward_as_tuple(args...));
+              if (invoke_listener<Results>(completion, event, *listener_entry, std::span<const Item>(&item, 1))) {
+                return true;
+              }
+            }
+            continue;
+          }
+        }
+        report_signature_mismatch(event);
+        continue;
+      }
+
+      if (claim(event, *listener_entry)) {
+        if (invoke_listener<Results, EmitArgs...>(completion, event, *listener_entry, args...)) {
+          return true;
+        }
+      }
+    }
+    return false;
+  }
 
+  //
+  // Readers only. Resumes the coroutines waiting for this event, oldest
+  // first, on the emitting thread. Waiters for other argument types keep
+  // waiting.
+  //
+  template <typename... Args>
+  void resume_waiters(Event& event, const Args&... args) {
+    Waiter* waiter = event.waiters.exchange(nullptr, std::memory_order_acquire);
+    Waiter* oldest = nullptr;
+    while (waiter != nullptr) {
+      Waiter* newer = waiter;
+      waiter = waiter->next;
+      newer->next = oldest;
+      oldest = newer;
+    }
 
-  int listeners() const {
-    std::lock_guard<std::mutex> lock(mtx_);
-    return this->_listeners;
+    const std::tuple<const Args&...> arguments(args...);
+    while (oldest != nullptr) {
+      Waiter* current = oldest;
+      oldest = current->next;  // Resuming may end the waiter's coroutine.
+      if (current->signature == &signature_tag<const Args&...>) {
+        current->resume(*current, &arguments);
+      } else {
+        report_signature_mismatch(event);
+        push_waiter(event, *current);
+      }
+    }
   }
 
-  template <typename Callback>
-  void on(const std::string& name, Callback&& cb) {
-    add_listener(name, std::forward<Callback>(cb), false /*is_once_flag*/);
+  static void push_waiter(Event& event, Waiter& waiter) {
+    waiter.next = event.waiters.load(std::memory_order_relaxed);
+    while (!event.waiters.compare_exchange_weak(waiter.next, &waiter, std::memory_order_release, std::memory_order_relaxed)) {
+    }
   }
 
-  template <typename Callback>
-  void once(const std::string& name, Callback&& cb) {
-    add_listener(name, std::forward<Callback>(cb), true /*is_once_flag*/);
+  //
+  // Readers only, with an epoch guard held. Listeners taking `const T&` are
+  // called once per item; listeners taking `std::span<const T>` are called
+  // once with the whole batch. Each listener sees the whole batch before the
+  // next listener is called.
+  //
+  template <typename T>
+  void dispatch_batch(Event& event, std::span<const T> items) {
+    const ListenerList* snapshot = event.listeners.load();
+    if (snapshot != nullptr && snapshot->has_results) {
+      // A listener may stop any one item, so items go through one at a time.
+      for (const T& item : items) {
+        dispatch(event, item);
+      }
+      return;
+    }
+    count_emits(event, items.size());
+    if (items.empty()) {
+      return;
+    }
+    if (snapshot != nullptr) {
+      call_batch_listeners(event, *snapshot, items);
+    }
+    if (event.waiters.load(std::memory_order_acquire) != nullptr) {
+      // Like a once listener, a waiter only gets the first item.
+      resume_waiters<T>(event, items[0]);
+    }
   }
 
-  void off() {
-    std::lock_guard<std::mutex> lock(mtx_);
-    events.clear();
-    this->_listeners = 0;
+  template <typename T>
+  void call_batch_listeners(Event& event, const ListenerList& snapshot, std::span<const T> items) {
+
+    const void* item_signature = &signature_tag<const T&>;
+
+    for (Listener* listener_entry : snapshot.listeners) {
+      if (!listener_entry->active.load(std::memory_order_relaxed)) {
+        continue;
+      }
+      const void* signature = listener_entry->callback.signature();
+
+      if (signature == item_signature) {
+        if (listener_entry->is_once) {
+          // A once listener only gets the first item, as it would from emit().
+          if (claim(event, *listener_entry)) {
+            invoke_listener(nullptr, event, *listener_entry, items[0]);
+          }
+          continue;
+        }
+        for (std::size_t i = 0; i < items.size() && listener_entry->active.load(std::memory_order_relaxed); ++i) {
+          invoke_listener(nullptr, event, *listener_entry, items[i]);
+        }
+      } else if (signature == batch_signature<T>()) {
+        if (claim(event, *listener_entry)) {
+          invoke_listener(nullptr, event, *listener_entry, items);
+        }
+      } else {
+        report_signature_mismatch(event);
+      }
+    }
   }
 
-  void off(const std::string& name) {
-    std::lock_guard<std::mutex> lock(mtx_);
-    auto it = events.find(name);
-    if (it != events.end()) {
-      this->_listeners -= it->second.size();
-      events.erase(it);
+  //
+  // Readers only. Whether `listener` should be called now. Exactly one emit
+  // wins a once listener, and queues the event so that the next writer
+  // drops its node.
+  //
+  bool claim(Event& event, Listener& listener) {
+    if (!listener.is_once) {
+      return true;
+    }
+    if (!listener.active.exchange(false)) {
+      return false;
+    }
+    if (listener.from_pattern) {
+      pattern_listeners_--;
+    } else {
+      shard_of(event).listeners--;
+      schedule_compaction(event);
     }
+    return true;
   }
 
-  template <typename... EmitArgs>
-  void emit(const std::string& name, EmitArgs&&... args) {
-    std::vector<ListenerWrapper> current_call_list;
-    bool has_any_once_listener_in_list = false;
+  template <typename T>
+  static const void* batch_signature() {
+    return &signature_tag<const std::span<const T>&>;
+  }
 
-    {
-      std::lock_guard<std::mutex> lock(mtx_);
-      auto map_it = events.find(name);
-      if (map_it == events.end() || map_it->second.empty()) {
-        return;
+  //
+  // Returns true if the listener returned Propagation::Stop, which can only
+  // happen when `Results` is set. Exceptions thrown by the listener
+  // propagate out of the emit, except std::bad_function_call: listeners are
+  // stored as the callable itself, so that one can only come from an empty
+  // std::function registered as a listener, which is reported instead.
+  //
+  template <bool Results = false, typename... Args>
+  static bool invoke_listener(Completion* completion, const Event& event, const Listener& listener_entry, const Args&... args) {
+    try {
+      CallTimer timer(listener_entry);
+      if constexpr (Results) {
+        return invoke_for_result<const Args&...>(completion, listener_entry, args...);
       }
-      current_call_list = map_it->second;
+      listener_entry.callback.template invoke<const Args&...>(args...);
+    } catch (const std::bad_function_call& e) {
+      std::cerr << "Emit error for event '" << event.name << "': "
+                << "Bad function call (e.g. empty std::function). Details: " << e.what()
+                << std::endl;
+    }
+    return false;
+  }
 
-      for(const auto& wrapper : current_call_list) {
-        if (wrapper.is_once) {
-          has_any_once_listener_in_list = true;
-          break;
+  //
+  // Calls a listener and acts on what it returns: a Propagation may stop
+  // the emit, and a Task is started under `completion`.
+  //
+  template <typename... Args, typename... CallArgs>
+  static bool invoke_for_result(Completion* completion, const Listener& listener_entry, CallArgs&&... args) {
+    switch (listener_entry.result) {
+      case ResultKind::Propagation:
+        return listener_entry.callback.template invoke_returning<Propagation, Args...>(std::forward<CallArgs>(args)...) == Propagation::Stop;
+      case ResultKind::Task:
+        listener_entry.callback.template invoke_returning<Task, Args...>(std::forward<CallArgs>(args)...).start(completion);
+        return false;
+      case ResultKind::None:
+        break;
+    }
+    listener_entry.callback.template invoke<Args...>(std::forward<CallArgs>(args)...);
+    return false;
+  }
+
+  static void report_signature_mismatch(const Event& event) {
+    std::cerr << "Emit error for event '" << event.name << "': "
+              << "Callback signature mismatch."
+              << std::endl;
+  }
+
+  //
+  // Readers only, with an epoch guard held. For callers that have proven at
+  // compile time that every listener on `event` was created for `Args`.
+  //
+  template <typename... Args, typename... CallArgs>
+  void dispatch_unchecked(Event& event, CallArgs&&... args) {
+    count_emits(event);
+    const ListenerList* snapshot = event.listeners.load();
+    if (snapshot == nullptr) {
+      return;
+    }
+
+    if (!snapshot->has_results) {
+      for (Listener* listener_entry : snapshot->listeners) {
+        if (listener_entry->active.load(std::memory_order_relaxed) && claim(event, *listener_entry)) {
+          CallTimer timer(*listener_entry);
+          listener_entry->callback.template invoke<Args...>(args...);
         }
       }
+      return;
     }
 
-    std::tuple<EmitArgs...> captured_args_tuple(std::forward<EmitArgs>(args)...);
+    for (Listener* listener_entry : snapshot->listeners) {
+      if (listener_entry->active.load(std::memory_order_relaxed) && claim(event, *listener_entry)) {
+        CallTimer timer(*listener_entry);
+        if (invoke_for_result<Args...>(nullptr, *listener_entry, args...)) {
+          return;
+        }
+      }
+    }
+  }
+};
 
-    for (const auto& listener_entry : current_call_list) {
-      try {
-        using TargetFunctionType = std::function<void(std::decay_t<EmitArgs>...)>;
-        const auto& storable_func_any = listener_entry.callback;
-        const auto& storable_func = std::any_cast<const TargetFunctionType&>(storable_func_any);
+inline bool EventEmitter::Subscription::unsubscribe() {
+  return emitter_ != nullptr && emitter_->unsubscribe(slot_, generation_);
+}
 
-        std::apply([&](auto&&... tuple_args) {
-          storable_func(std::forward<decltype(tuple_args)>(tuple_args)...);
-        }, captured_args_tuple);
+inline bool EventEmitter::Subscription::active() const {
+  return emitter_ != nullptr && emitter_->is_subscribed(slot_, generation_);
+}
+//
+// Names that are not members of EventEmitter: the event schema used by
+// TypedEmitter, and the `_event` literal. `using namespace
+// eventemitter::literals;` brings in the literal alone.
+//
+namespace eventemitter {
 
-      } catch (const std::bad_any_cast& e) {
-        std::cerr << "Emit error for event '" << name << "': "
-                  << "Callback signature mismatch. Details: " << e.what()
-                  << std::endl;
-      } catch (const std::bad_function_call& e) {
-         std::cerr << "Emit error for event '" << name << "': "
-                   << "Bad function call (e.g. empty std::function). Details: " << e.what()
-                   << std::endl;
-      }
+inline namespace literals {
+
+constexpr EventEmitter::EventName operator""_event(const char* name, std::size_t length) {
+  return EventEmitter::EventName(std::string_view(name, length));
+}
+
+}  // namespace literals
+
+//
+// A compile-time event name, usable as a template argument:
+// `Event<"tick", void(int)>`.
+//
+template <std::size_t N>
+struct EventLiteral {
+  char value[N] = {};
+
+  constexpr EventLiteral(const char (&str)[N]) {
+    for (std::size_t i = 0; i < N; ++i) {
+      value[i] = str[i];
     }
+  }
+
+  constexpr std::string_view view() const { return std::string_view(value, N - 1); }
+};
+
+//
+// Declares an event for TypedEmitter. Listeners receive every argument as an
+// lvalue: by-value parameters arrive as `const T&`, reference parameters as
+// they were declared.
+//
+template <EventLiteral Name, typename Signature>
+struct Event;
 
-    if (has_any_once_listener_in_list) {
-      std::lock_guard<std::mutex> lock(mtx_);
-      auto map_it = events.find(name);
-      if (map_it != events.end()) {
-        std::vector<ListenerWrapper>& original_listeners_ref = map_it->second;
-        std::size_t original_size = original_listeners_ref.size();
+template <EventLiteral Name, typename... Args>
+struct Event<Name, void(Args...)> {
+  static constexpr auto name = Name;
 
-        original_listeners_ref.erase(
-          std::remove_if(original_listeners_ref.begin(), original_listeners_ref.end(),
-                         [](const ListenerWrapper& entry) {
-                           return entry.is_once;
-                         }),
-          original_listeners_ref.end()
-        );
+  template <typename T>
+  using listener_arg_t = std::conditional_t<std::is_reference_v<T>, T&, const T&>;
 
-        std::size_t removed_count = original_size - original_listeners_ref.size();
-        this->_listeners -= removed_count;
+  using ListenerArguments = std::tuple<listener_arg_t<Args>...>;
 
-        if (original_listeners_ref.empty()) {
-          events.erase(map_it);
+  template <typename Callback>
+  static constexpr bool accepts_listener = std::is_invocable_v<Callback&, listener_arg_t<Args>...>;
+
+  template <typename... EmitArgs>
+  static constexpr bool accepts_arguments = std::is_invocable_v<void (*)(Args...), EmitArgs...>;
+
+  // An emitted argument already of its declared type is held by reference;
+  // any other is converted to that type once.
+  template <typename Arg, typename EmitArg>
+  using held_t = std::conditional_t<std::is_same_v<std::remove_cvref_t<EmitArg>, std::remove_cvref_t<Arg>>,
+                                    EmitArg&&, std::remove_cvref_t<Arg>>;
+
+  //
+  // Hands the emitted arguments on as lvalues of the declared parameter
+  // types, converting only those of another type, so a by-value
+  // std::string parameter does not copy the caller's string.
+  //
+  template <typename Fn, typename... EmitArgs>
+  static void with_arguments(Fn&& fn, EmitArgs&&... args) {
+    std::tuple<held_t<Args, EmitArgs>...> held(std::forward<EmitArgs>(args)...);
+    std::apply([&](auto&... values) {
+      fn(static_cast<listener_arg_t<Args>>(values)...);
+    }, held);
+  }
+};
+
+}  // namespace eventemitter
+
+//
+// A front end for schemas known at compile time, e.g.
+// `TypedEmitter<eventemitter::Event<"tick", void(int)>, eventemitter::Event<"close", void()>>`.
+// `on<"tick">(cb)` and `emit<"tick">(42)` resolve to the event's listener
+// list at compile time, and signature mismatches are compile errors, so the
+// hot path does no name lookup and no signature check.
+//
+template <typename... Events>
+class TypedEmitter : private EventEmitter {
+  static constexpr std::array<std::string_view, sizeof...(Events)> names = {Events::name.view()...};
+
+  static constexpr bool has_unique_names() {
+    for (std::size_t i = 0; i < names.size(); ++i) {
+      for (std::size_t j = i + 1; j < names.size(); ++j) {
+        if (names[i] == names[j]) {
+          return false;
         }
       }
     }
+    return true;
+  }
+  static_assert(has_unique_names(), "TypedEmitter events must have unique names");
+
+  static constexpr std::size_t find_name(std::string_view name) {
+    for (std::size_t i = 0; i < names.size(); ++i) {
+      if (names[i] == name) {
+        return i;
+      }
+    }
+    return names.size();
+  }
+
+  template <eventemitter::EventLiteral Name>
+  static constexpr std::size_t index_of() {
+    constexpr std::size_t index = find_name(Name.view());
+    static_assert(index < names.size(), "Unknown event name");
+    return index;
+  }
+
+  template <eventemitter::EventLiteral Name>
+  using event_t = std::tuple_element_t<index_of<Name>(), std::tuple<Events...>>;
+
+  //
+  // Events are interned in declaration order into a fresh emitter, so the
+  // event at index `I` has EventId `I`.
+  //
+  template <eventemitter::EventLiteral Name>
+  EventEmitter::Event& event() {
+    return this->event_at(id_of<Name>().index_);
+  }
+
+  template <eventemitter::EventLiteral Name>
+  static EventId id_of() {
+    return EventId(std::uint32_t(index_of<Name>()));
+  }
+
+  template <typename Callback, typename... ListenerArgs>
+  static constexpr ResultKind listener_result =
+    result_kind<std::invoke_result_t<std::decay_t<Callback>&, ListenerArgs...>>;
+
+  template <typename... ListenerArgs, typename Callback>
+  InlineFunction make_listener(std::tuple<ListenerArgs...>*, Callback&& cb) {
+    return InlineFunction::create_returning<result_type_t<listener_result<Callback, ListenerArgs...>>, ListenerArgs...>(
+      std::forward<Callback>(cb), this->resource_);
+  }
+
+  template <typename Callback, typename... ListenerArgs>
+  static constexpr ResultKind result_of(std::tuple<ListenerArgs...>*) {
+    return listener_result<Callback, ListenerArgs...>;
+  }
+
+  template <typename... ListenerArgs, typename... CallArgs>
+  void dispatch_typed(EventEmitter::Event& event, std::tuple<ListenerArgs...>*, CallArgs&... args) {
+    this->template dispatch_unchecked<ListenerArgs...>(event, args...);
+  }
+
+  template <eventemitter::EventLiteral Name, typename Callback>
+  Subscription add_typed_listener(Callback&& cb, bool is_once_flag, int priority) {
+    static_assert(event_t<Name>::template accepts_listener<std::decay_t<Callback>>,
+                  "Listener cannot be called with this event's arguments");
+    using ListenerArguments = typename event_t<Name>::ListenerArguments;
+    constexpr ResultKind result = result_of<Callback>(static_cast<ListenerArguments*>(nullptr));
+    return this->subscribe(
+      event<Name>(),
+      make_listener(static_cast<ListenerArguments*>(nullptr), std::forward<Callback>(cb)),
+      {is_once_flag, result, priority});
+  }
+
+public:
+  using EventEmitter::Subscription;
+  using EventEmitter::ScopedSubscription;
+  using EventEmitter::Propagation;
+  using EventEmitter::Task;
+  using EventEmitter::maxListeners;
+  using EventEmitter::listeners;
+  using EventEmitter::setLeakWarningHandler;
+  using EventEmitter::stats;
+
+  TypedEmitter() : TypedEmitter(std::pmr::get_default_resource()) {}
+
+  explicit TypedEmitter(std::pmr::memory_resource* resource) : EventEmitter(resource) {
+    (EventEmitter::id(Events::name.view()), ...);
+  }
+
+  template <eventemitter::EventLiteral Name, typename Callback>
+  Subscription on(Callback&& cb, int priority = 0) {
+    return add_typed_listener<Name>(std::forward<Callback>(cb), false /*is_once_flag*/, priority);
+  }
+
+  template <eventemitter::EventLiteral Name, typename Callback>
+  Subscription once(Callback&& cb, int priority = 0) {
+    return add_typed_listener<Name>(std::forward<Callback>(cb), true /*is_once_flag*/, priority);
+  }
+
+  template <eventemitter::EventLiteral Name>
+  void off() {
+    EventEmitter::off(id_of<Name>());
+  }
+
+  void off() {
+    EventEmitter::off();
+  }
+
+  template <eventemitter::EventLiteral Name, typename... EmitArgs>
+  void emit(EmitArgs&&... args) {
+    using E = event_t<Name>;
+    static_assert(E::template accepts_arguments<EmitArgs...>,
+                  "Arguments do not match this event's signature");
+
+    EpochDomain::Guard guard(this->epoch_);
+    E::with_arguments([&](auto&... typed_args) {
+      dispatch_typed(event<Name>(), static_cast<typename E::ListenerArguments*>(nullptr), typed_args...);
+    }, std::forward<EmitArgs>(args)...);
   }
 };
 
@@ -1,14 +1,145 @@
 #include <iostream>
 #include <vector>
+#include <deque>
+#include <functional>
+#include <mutex>
 #include <thread>
 #include <atomic>
 #include <string>
 #include <chrono>
 #include <iomanip>
+#include <algorithm>
+#include <span>
+#include <cstdlib>
+#include <new>
+#include <fstream>
+#include <sstream>
+#include <cmath>
+#include <cstring>
+#include <cstdint>
+#include <utility>
+#include <coroutine>
+#include <exception>
+
+#include <sys/wait.h>
+#include <unistd.h>
 
 #include "../index.hxx"
+#if defined(__linux__)
+#include "../shm.hxx"
+#endif
+#include "../record.hxx"
 
 std::atomic<long long> perf_callback_counter(0);
+std::atomic<long long> perf_allocation_counter(0);
+std::atomic<long long> perf_allocated_bytes(0);
+
+// Count every heap allocation so scenarios can report allocations per emit.
+void* operator new(std::size_t size) {
+  perf_allocation_counter.fetch_add(1, std::memory_order_relaxed);
+  perf_allocated_bytes.fetch_add((long long)size, std::memory_order_relaxed);
+  if (void* ptr = std::malloc(size ? size : 1)) return ptr;
+  throw std::bad_alloc();
+}
+// GCC pairs inlined coroutine frame deletes with the replaced operator new
+// above and warns about the free().
+#if defined(__GNUC__) && !defined(__clang__)
+#pragma GCC diagnostic push
+#pragma GCC diagnostic ignored "-Wmismatched-new-delete"
+#endif
+void operator delete(void* ptr) noexcept { std::free(ptr); }
+void operator delete(void* ptr, std::size_t) noexcept { std::free(ptr); }
+#if defined(__GNUC__) && !defined(__clang__)
+#pragma GCC diagnostic pop
+#endif
+
+// std::pmr::new_delete_resource, which backs the emitter's allocations by
+// default, allocates through the aligned forms, so they are counted too.
+// Over-aligned requests are carved out of a counted plain allocation, which
+// is remembered just below the aligned pointer.
+void* operator new(std::size_t size, std::align_val_t alignment) {
+  std::size_t align = std::max(static_cast<std::size_t>(alignment), alignof(std::max_align_t));
+  auto raw = static_cast<char*>(::operator new(size + align));
+  char* aligned = raw + align - reinterpret_cast<std::uintptr_t>(raw) % align;
+  reinterpret_cast<void**>(aligned)[-1] = raw;
+  return aligned;
+}
+
+void operator delete(void* ptr, std::align_val_t) noexcept {
+  if (ptr != nullptr) ::operator delete(static_cast<void**>(ptr)[-1]);
+}
+void operator delete(void* ptr, std::size_t, std::align_val_t alignment) noexcept { ::operator delete(ptr, alignment); }
+
+// std::stable_sort's temporary buffer comes from here and goes back through
+// the replaced delete above.
+void* operator new(std::size_t size, const std::nothrow_t&) noexcept {
+  perf_allocation_counter.fetch_add(1, std::memory_order_relaxed);
+  perf_allocated_bytes.fetch_add((long long)size, std::memory_order_relaxed);
+  return std::malloc(size ? size : 1);
+}
+
+// One entry of the JSON report. Parameters identify the run, so reports
+// from two versions of index.hxx can be joined on (scenario, params) and
+// their metrics compared.
+struct PerfRecord {
+  std::string scenario;
+  std::vector<std::pair<std::string, std::string>> params;  // Values already JSON-encoded.
+  std::vector<std::pair<std::string, double>> metrics;
+
+  PerfRecord& param(const std::string& key, long long value) {
+    params.emplace_back(key, std::to_string(value));
+    return *this;
+  }
+
+  PerfRecord& param(const std::string& key, const std::string& value) {
+    std::string encoded = "\"";
+    for (char c : value) {
+      if (c == '"' || c == '\\') encoded += '\\';
+      encoded += c;
+    }
+    params.emplace_back(key, encoded + "\"");
+    return *this;
+  }
+
+  PerfRecord& metric(const std::string& key, double value) {
+    metrics.emplace_back(key, value);
+    return *this;
+  }
+};
+
+std::vector<PerfRecord> perf_records;
+
+// Adds a record to the report. Call it outside measured sections; it
+// allocates.
+PerfRecord& perf_record(const std::string& scenario) {
+  perf_records.push_back({scenario, {}, {}});
+  return perf_records.back();
+}
+
+void perf_write_json(std::ostream& out) {
+  auto number = [](double value) {
+    if (!std::isfinite(value)) return std::string("null");
+    std::ostringstream text;
+    text << std::setprecision(6) << value;
+    return text.str();
+  };
+
+  out << "{\n  \"format\": 1,\n  \"hardware_concurrency\": " << std::thread::hardware_concurrency()
+      << ",\n  \"records\": [";
+  for (std::size_t i = 0; i < perf_records.size(); ++i) {
+    const PerfRecord& record = perf_records[i];
+    out << (i ? ",\n" : "\n") << "    {\"scenario\": \"" << record.scenario << "\", \"params\": {";
+    for (std::size_t j = 0; j < record.params.size(); ++j) {
+      out << (j ? ", " : "") << "\"" << record.params[j].first << "\": " << record.params[j].second;
+    }
+    out << "}, \"metrics\": {";
+    for (std::size_t j = 0; j < record.metrics.size(); ++j) {
+      out << (j ? ", " : "") << "\"" << record.metrics[j].first << "\": " << number(record.metrics[j].second);
+    }
+    out << "}}";
+  }
+  out << "\n  ]\n}\n";
+}
 
 const int NUM_PERF_THREADS = 4;
 const int EMITS_PER_THREAD_PERF = 10000;
@@ -33,7 +164,1135 @@ void perf_worker(EventEmitter& emitter, int thread_id) {
   }
 }
 
-int main() {
+const int ALLOC_EMITS_PERF = 10000;
+
+// Emits a single event with a growing number of listeners and reports how
+// many heap allocations each emit performs on the dispatch path.
+void perf_allocations_per_emit() {
+  std::cout << "Allocations per emit" << std::endl;
+  std::cout << "----------------------------------------" << std::endl;
+
+  for (int listener_count : {1, 5, 20, 50}) {
+    EventEmitter emitter;
+    emitter.maxListeners = listener_count + 1;
+    long long sink = 0;
+
+    for (int i = 0; i < listener_count; ++i) {
+      emitter.on("alloc_event", [&](int value) { sink += value; });
+    }
+
+    long long allocations_before = perf_allocation_counter.load();
+    auto start_time = std::chrono::high_resolution_clock::now();
+
+    for (int i = 0; i < ALLOC_EMITS_PERF; ++i) {
+      emitter.emit("alloc_event", i);
+    }
+
+    auto end_time = std::chrono::high_resolution_clock::now();
+    long long allocations = perf_allocation_counter.load() - allocations_before;
+    std::chrono::duration<double, std::nano> duration_ns = end_time - start_time;
+
+    std::cout << "Listeners: " << std::setw(3) << listener_count
+              << "  allocations/emit: " << (double)allocations / ALLOC_EMITS_PERF
+              << "  ns/emit: " << duration_ns.count() / ALLOC_EMITS_PERF
+              << (sink == 0 ? " (no callbacks ran)" : "") << std::endl;
+    perf_record("allocations_per_emit")
+      .param("listeners", listener_count)
+      .metric("allocations_per_emit", (double)allocations / ALLOC_EMITS_PERF)
+      .metric("ns_per_emit", duration_ns.count() / ALLOC_EMITS_PERF);
+  }
+  std::cout << "----------------------------------------" << std::endl;
+}
+
+template <std::size_t CaptureBytes>
+void perf_report_registration() {
+  EventEmitter emitter;
+  EventEmitter::EventId event_id = emitter.id("registration_event");
+  struct { char bytes[CaptureBytes]; } capture = {};
+
+  long long allocations_before = perf_allocation_counter.load();
+  emitter.on(event_id, [capture](int value) { (void)capture; (void)value; });
+  long long allocations = perf_allocation_counter.load() - allocations_before;
+
+  std::cout << "Capture bytes: " << std::setw(3) << CaptureBytes
+            << "  allocations/on: " << allocations << std::endl;
+  perf_record("registration")
+    .param("capture_bytes", (long long)CaptureBytes)
+    .metric("allocations", allocations);
+}
+
+// Reports how many allocations registering the first listener costs. The
+// listener node, the list, its buffer and the first subscription slot
+// account for four; anything beyond that is the callable.
+void perf_registration_allocations() {
+  std::cout << "Allocations per registration" << std::endl;
+  std::cout << "----------------------------------------" << std::endl;
+  perf_report_registration<8>();
+  perf_report_registration<48>();
+  perf_report_registration<64>();
+  std::cout << "----------------------------------------" << std::endl;
+}
+
+const int PAYLOAD_EMITS_PERF = 10000;
+const int PAYLOAD_LISTENERS_PERF = 10;
+const std::size_t PAYLOAD_BYTES_PERF = 4096;
+
+template <typename Payload, typename Listener>
+void perf_report_payload(const char* label, const Payload& payload, Listener listener) {
+  EventEmitter emitter;
+  emitter.maxListeners = PAYLOAD_LISTENERS_PERF + 1;
+  for (int i = 0; i < PAYLOAD_LISTENERS_PERF; ++i) {
+    emitter.on("payload_event", listener);
+  }
+
+  long long bytes_before = perf_allocated_bytes.load();
+  auto start_time = std::chrono::high_resolution_clock::now();
+  for (int i = 0; i < PAYLOAD_EMITS_PERF; ++i) {
+    emitter.emit("payload_event", payload);
+  }
+  auto end_time = std::chrono::high_resolution_clock::now();
+  long long bytes = perf_allocated_bytes.load() - bytes_before;
+  std::chrono::duration<double, std::nano> duration_ns = end_time - start_time;
+
+  std::cout << std::left << std::setw(30) << label << std::right
+            << "bytes copied/emit: " << std::setw(8) << (double)bytes / PAYLOAD_EMITS_PERF
+            << "  ns/emit: " << duration_ns.count() / PAYLOAD_EMITS_PERF << std::endl;
+  perf_record("large_payload")
+    .param("payload", label)
+    .metric("bytes_copied_per_emit", (double)bytes / PAYLOAD_EMITS_PERF)
+    .metric("ns_per_emit", duration_ns.count() / PAYLOAD_EMITS_PERF);
+}
+
+// Emits 4 KB payloads to 10 listeners. Payload copies allocate, so the bytes
+// allocated per emit are the bytes copied per emit.
+void perf_large_payloads() {
+  std::cout << "Large payloads (" << PAYLOAD_BYTES_PERF << " bytes, "
+            << PAYLOAD_LISTENERS_PERF << " listeners)" << std::endl;
+  std::cout << "----------------------------------------" << std::endl;
+
+  static std::size_t sink = 0;
+  std::string text(PAYLOAD_BYTES_PERF, 'x');
+  std::vector<char> buffer(PAYLOAD_BYTES_PERF, 'x');
+
+  perf_report_payload("std::string const&", text, [](const std::string& s) { sink += s.size(); });
+  perf_report_payload("std::vector<char> const&", buffer, [](const std::vector<char>& v) { sink += v.size(); });
+  perf_report_payload("std::string by value", text, [](std::string s) { sink += s.size(); });
+  perf_report_payload("std::vector<char> by value", buffer, [](std::vector<char> v) { sink += v.size(); });
+  std::cout << "----------------------------------------" << std::endl;
+}
+
+const int BATCH_TOTAL_ITEMS_PERF = 4096 * 64;
+const int BATCH_LISTENERS_PERF = 5;
+
+// Delivers the same number of items through emit() and through emitBatch()
+// at several batch sizes, to per-item and to span listeners.
+void perf_batched_emit() {
+  std::cout << "Batched emit (" << BATCH_TOTAL_ITEMS_PERF << " items, "
+            << BATCH_LISTENERS_PERF << " listeners)" << std::endl;
+  std::cout << "----------------------------------------" << std::endl;
+
+  std::vector<long long> items(BATCH_TOTAL_ITEMS_PERF);
+  for (int i = 0; i < BATCH_TOTAL_ITEMS_PERF; ++i) items[i] = i;
+
+  for (bool span_listeners : {false, true}) {
+    EventEmitter emitter;
+    long long sink = 0;
+    EventEmitter::EventId event_id = emitter.id("batch_event");
+    for (int i = 0; i < BATCH_LISTENERS_PERF; ++i) {
+      if (span_listeners) {
+        emitter.on(event_id, [&](std::span<const long long> batch) {
+          for (long long v : batch) sink += v;
+        });
+      } else {
+        emitter.on(event_id, [&](long long v) { sink += v; });
+      }
+    }
+
+    auto start_time = std::chrono::high_resolution_clock::now();
+    for (long long v : items) {
+      emitter.emit(event_id, v);
+    }
+    std::chrono::duration<double, std::nano> single_ns = std::chrono::high_resolution_clock::now() - start_time;
+    std::cout << (span_listeners ? "span listeners " : "item listeners ")
+              << " emit()              ns/item: " << single_ns.count() / BATCH_TOTAL_ITEMS_PERF << std::endl;
+    perf_record("batch")
+      .param("listener_kind", span_listeners ? "span" : "item")
+      .param("batch_size", 0)
+      .metric("ns_per_item", single_ns.count() / BATCH_TOTAL_ITEMS_PERF);
+
+    for (int batch_size : {1, 16, 256, 4096}) {
+      start_time = std::chrono::high_resolution_clock::now();
+      for (int offset = 0; offset < BATCH_TOTAL_ITEMS_PERF; offset += batch_size) {
+        emitter.emitBatch(event_id, std::span<const long long>(items.data() + offset, batch_size));
+      }
+      std::chrono::duration<double, std::nano> batch_ns = std::chrono::high_resolution_clock::now() - start_time;
+      std::cout << (span_listeners ? "span listeners " : "item listeners ")
+                << " emitBatch(" << std::setw(4) << batch_size << ")     ns/item: "
+                << batch_ns.count() / BATCH_TOTAL_ITEMS_PERF << std::endl;
+      perf_record("batch")
+        .param("listener_kind", span_listeners ? "span" : "item")
+        .param("batch_size", batch_size)
+        .metric("ns_per_item", batch_ns.count() / BATCH_TOTAL_ITEMS_PERF);
+    }
+    if (sink == 0) std::cout << "(no callbacks ran)" << std::endl;
+  }
+  std::cout << "----------------------------------------" << std::endl;
+}
+
+const int RESOLVE_EMITS_PERF = 200000;
+
+template <typename EmitFn>
+void perf_report_resolution(const char* label, EmitFn&& emit_once) {
+  auto start_time = std::chrono::high_resolution_clock::now();
+  for (int i = 0; i < RESOLVE_EMITS_PERF; ++i) {
+    emit_once(i);
+  }
+  auto end_time = std::chrono::high_resolution_clock::now();
+  std::chrono::duration<double, std::nano> duration_ns = end_time - start_time;
+  std::cout << std::left << std::setw(28) << label << std::right
+            << "ns/emit: " << duration_ns.count() / RESOLVE_EMITS_PERF << std::endl;
+  perf_record("name_resolution")
+    .param("form", label)
+    .metric("ns_per_emit", duration_ns.count() / RESOLVE_EMITS_PERF);
+}
+
+// Compares the cost of resolving an event by name in its various forms
+// against emitting through a pre-resolved EventId.
+void perf_name_resolution() {
+  std::cout << "Event name resolution (1 listener, 100 events)" << std::endl;
+  std::cout << "----------------------------------------" << std::endl;
+
+  EventEmitter emitter;
+  emitter.maxListeners = 200;
+  long long sink = 0;
+  for (int i = 0; i < 100; ++i) {
+    emitter.on("resolve_event_" + std::to_string(i), [&](int value) { sink += value; });
+  }
+
+  const std::string prebuilt_name = "resolve_event_42";
+  static constexpr EventEmitter::EventName literal_name{"resolve_event_42"};
+  EventEmitter::EventId event_id = emitter.id(prebuilt_name);
+
+  perf_report_resolution("std::to_string per emit", [&](int i) {
+    emitter.emit("resolve_event_" + std::to_string(42), i);
+  });
+  perf_report_resolution("prebuilt std::string", [&](int i) {
+    emitter.emit(prebuilt_name, i);
+  });
+  perf_report_resolution("constexpr EventName", [&](int i) {
+    emitter.emit(literal_name, i);
+  });
+  perf_report_resolution("EventId", [&](int i) {
+    emitter.emit(event_id, i);
+  });
+
+  TypedEmitter<eventemitter::Event<"resolve_event_42", void(int)>> typed_emitter;
+  typed_emitter.on<"resolve_event_42">([&](int value) { sink += value; });
+  perf_report_resolution("TypedEmitter", [&](int i) {
+    typed_emitter.emit<"resolve_event_42">(i);
+  });
+
+  if (sink == 0) {
+    std::cout << "(no callbacks ran)" << std::endl;
+  }
+  std::cout << "----------------------------------------" << std::endl;
+}
+
+long long perf_now_ns() {
+  return std::chrono::duration_cast<std::chrono::nanoseconds>(
+    std::chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+// Returns the p-th percentile (0-100) of `samples`, sorting them in place.
+long long perf_percentile(std::vector<long long>& samples, double p) {
+  if (samples.empty()) return 0;
+  std::sort(samples.begin(), samples.end());
+  std::size_t index = (std::size_t)(p / 100.0 * (samples.size() - 1));
+  return samples[index];
+}
+
+// What one measured loop reports.
+struct PerfEmitResult {
+  double ns_per_emit = 0;  // Wall time per emit on one thread.
+  double emits_per_sec = 0;  // Across all threads.
+  double allocations_per_emit = 0;
+  long long p50 = 0, p99 = 0, p999 = 0;
+};
+
+// Runs `emit_once(thread, i)` on `num_threads` threads twice: once untimed,
+// for throughput and allocations, then with every call timed, for the
+// latency percentiles. Threads are started before either pass begins so
+// their own allocations are not counted. Timed samples include one clock
+// read.
+template <typename EmitFn>
+PerfEmitResult perf_measure_emits(int num_threads, int emits_per_thread, EmitFn emit_once) {
+  PerfEmitResult result;
+  const long long total = (long long)num_threads * emits_per_thread;
+  std::vector<std::vector<long long>> samples(num_threads, std::vector<long long>(emits_per_thread));
+  std::atomic<int> phase(0), ready(0), finished(0);
+
+  std::vector<std::thread> threads;
+  for (int t = 0; t < num_threads; ++t) {
+    threads.emplace_back([&, t]() {
+      ready++;
+      while (phase.load() == 0) std::this_thread::yield();
+      for (int i = 0; i < emits_per_thread; ++i) {
+        emit_once(t, i);
+      }
+      finished++;
+      while (phase.load() == 1) std::this_thread::yield();
+      for (int i = 0; i < emits_per_thread; ++i) {
+        long long before = perf_now_ns();
+        emit_once(t, i);
+        samples[t][i] = perf_now_ns() - before;
+      }
+    });
+  }
+  while (ready.load() < num_threads) std::this_thread::yield();
+
+  long long allocations_before = perf_allocation_counter.load();
+  auto start_time = std::chrono::high_resolution_clock::now();
+  phase = 1;
+  while (finished.load() < num_threads) std::this_thread::yield();
+  auto end_time = std::chrono::high_resolution_clock::now();
+  long long allocations = perf_allocation_counter.load() - allocations_before;
+  phase = 2;
+  for (std::thread& t : threads) {
+    t.join();
+  }
+
+  std::chrono::duration<double, std::nano> duration_ns = end_time - start_time;
+  result.ns_per_emit = duration_ns.count() * num_threads / total;
+  result.emits_per_sec = total / (duration_ns.count() / 1e9);
+  result.allocations_per_emit = (double)allocations / total;
+
+  std::vector<long long> all;
+  all.reserve(total);
+  for (auto& thread_samples : samples) {
+    all.insert(all.end(), thread_samples.begin(), thread_samples.end());
+  }
+  result.p50 = perf_percentile(all, 50);
+  result.p99 = perf_percentile(all, 99);
+  result.p999 = perf_percentile(all, 99.9);
+  return result;
+}
+
+const int MATRIX_CALLS_PERF = 400000;
+
+struct PerfMatrixCase {
+  int listeners;
+  const char* payload;
+  int threads;
+  int shared_percent;  // Share of emits that go to the name all threads use.
+};
+
+// Every thread has an event of its own and shares one with the others;
+// each has `listeners` empty listeners. Emits go to the shared event
+// `shared_percent` percent of the time.
+template <typename... Payload>
+void perf_emit_case(const PerfMatrixCase& config, const Payload&... payload) {
+  EventEmitter emitter;
+  emitter.maxListeners = 1 << 30;
+  EventEmitter::EventId shared = emitter.id("matrix_shared");
+  std::vector<EventEmitter::EventId> own;
+  for (int t = 0; t < config.threads; ++t) {
+    own.push_back(emitter.id("matrix_" + std::to_string(t)));
+  }
+  for (int i = 0; i < config.listeners; ++i) {
+    if (config.shared_percent > 0) {
+      emitter.on(shared, [](const Payload&...) {});
+    }
+    if (config.shared_percent < 100) {
+      for (EventEmitter::EventId id : own) {
+        emitter.on(id, [](const Payload&...) {});
+      }
+    }
+  }
+
+  int emits_per_thread = std::max(1000, MATRIX_CALLS_PERF / config.listeners);
+  PerfEmitResult result = perf_measure_emits(config.threads, emits_per_thread, [&](int t, int i) {
+    emitter.emit(i % 100 < config.shared_percent ? shared : own[t], payload...);
+  });
+
+  std::cout << "listeners: " << std::setw(4) << config.listeners
+            << "  payload: " << std::left << std::setw(10) << config.payload << std::right
+            << "  threads: " << config.threads
+            << "  shared: " << std::setw(3) << config.shared_percent << "%"
+            << "  ns/emit: " << std::setw(9) << result.ns_per_emit
+            << "  allocs/emit: " << result.allocations_per_emit
+            << "  p50/p99/p999: " << result.p50 << "/" << result.p99 << "/" << result.p999
+            << std::endl;
+
+  perf_record("emit")
+    .param("listeners", config.listeners)
+    .param("payload", config.payload)
+    .param("threads", config.threads)
+    .param("shared_percent", config.shared_percent)
+    .metric("ns_per_emit", result.ns_per_emit)
+    .metric("emits_per_sec", result.emits_per_sec)
+    .metric("allocations_per_emit", result.allocations_per_emit)
+    .metric("p50_ns", result.p50)
+    .metric("p99_ns", result.p99)
+    .metric("p999_ns", result.p999);
+}
+
+// Sweeps listener count, payload size, thread count and the share of emits
+// that go to a name every thread uses, one dimension at a time around
+// 10 listeners, an int payload, one thread and disjoint names.
+void perf_emit_matrix() {
+  std::cout << "Emit matrix (latency percentiles in ns, including one clock read)" << std::endl;
+  std::cout << "----------------------------------------" << std::endl;
+
+  const std::string small_payload(64, 'x');
+  const std::string large_payload(4096, 'x');
+
+  for (int listeners : {1, 10, 100, 1000}) {
+    perf_emit_case({listeners, "int", 1, 0}, 42);
+  }
+  perf_emit_case({10, "none", 1, 0});
+  perf_emit_case({10, "string64", 1, 0}, small_payload);
+  perf_emit_case({10, "string4096", 1, 0}, large_payload);
+  for (int threads : {1, 2, 4, 8}) {
+    for (int shared_percent : {0, 50, 100}) {
+      if (threads == 1 && shared_percent == 0) continue;  // Already covered above.
+      perf_emit_case({10, "int", threads, shared_percent}, 42);
+    }
+  }
+  std::cout << "----------------------------------------" << std::endl;
+}
+
+const int ASYNC_EMITS_PER_PRODUCER_PERF = 20000;
+
+// Producers queue timestamped events with emitAsync; dispatcher threads
+// record how long each one took to arrive.
+void perf_async_emit() {
+  std::cout << "emitAsync latency (2 dispatcher threads, capacity 4096)" << std::endl;
+  std::cout << "----------------------------------------" << std::endl;
+
+  for (int producers : {1, 4}) {
+    EventEmitter emitter;
+    emitter.configureAsync({2, 4096, EventEmitter::Backpressure::Block});
+
+    const int total = producers * ASYNC_EMITS_PER_PRODUCER_PERF;
+    std::vector<long long> end_to_end(total);
+    std::atomic<int> received(0);
+    std::vector<EventEmitter::EventId> ids;
+    for (int p = 0; p < producers; ++p) {
+      ids.push_back(emitter.id("async_event_" + std::to_string(p)));
+      emitter.on(ids.back(), [&](long long sent_ns) {
+        end_to_end[received++] = perf_now_ns() - sent_ns;
+      });
+    }
+
+    std::vector<std::vector<long long>> enqueue(producers);
+    std::vector<std::thread> threads;
+    auto start_time = std::chrono::high_resolution_clock::now();
+    for (int p = 0; p < producers; ++p) {
+      threads.emplace_back([&, p]() {
+        enqueue[p].reserve(ASYNC_EMITS_PER_PRODUCER_PERF);
+        for (int i = 0; i < ASYNC_EMITS_PER_PRODUCER_PERF; ++i) {
+          long long before = perf_now_ns();
+          emitter.emitAsync(ids[p], before);
+          enqueue[p].push_back(perf_now_ns() - before);
+        }
+      });
+    }
+    for (std::thread& t : threads) {
+      t.join();
+    }
+    emitter.drain();
+    auto end_time = std::chrono::high_resolution_clock::now();
+    std::chrono::duration<double> duration_s = end_time - start_time;
+
+    std::vector<long long> enqueue_all;
+    for (auto& samples : enqueue) {
+      enqueue_all.insert(enqueue_all.end(), samples.begin(), samples.end());
+    }
+
+    std::cout << "Producers: " << producers
+              << "  events/sec: " << total / duration_s.count() << std::endl;
+    std::cout << "  enqueue ns     p50: " << perf_percentile(enqueue_all, 50)
+              << "  p99: " << perf_percentile(enqueue_all, 99)
+              << "  p999: " << perf_percentile(enqueue_all, 99.9) << std::endl;
+    std::cout << "  end-to-end ns  p50: " << perf_percentile(end_to_end, 50)
+              << "  p99: " << perf_percentile(end_to_end, 99)
+              << "  p999: " << perf_percentile(end_to_end, 99.9) << std::endl;
+    perf_record("emit_async")
+      .param("producers", producers)
+      .metric("events_per_sec", total / duration_s.count())
+      .metric("enqueue_p50_ns", perf_percentile(enqueue_all, 50))
+      .metric("enqueue_p99_ns", perf_percentile(enqueue_all, 99))
+      .metric("enqueue_p999_ns", perf_percentile(enqueue_all, 99.9))
+      .metric("end_to_end_p50_ns", perf_percentile(end_to_end, 50))
+      .metric("end_to_end_p99_ns", perf_percentile(end_to_end, 99))
+      .metric("end_to_end_p999_ns", perf_percentile(end_to_end, 99.9));
+  }
+  std::cout << "----------------------------------------" << std::endl;
+}
+
+const int CHURN_STABLE_LISTENERS_PERF = 16;
+const int CHURN_EMITS_PER_THREAD_PERF = 200000;
+
+// Emitting threads share an event with 16 long-lived listeners while other
+// threads subscribe and unsubscribe short-lived ones as fast as they can.
+// Returns false if any emit missed a long-lived listener.
+bool perf_subscription_churn() {
+  std::cout << "Subscribe/unsubscribe churn (" << CHURN_STABLE_LISTENERS_PERF
+            << " long-lived listeners, " << CHURN_EMITS_PER_THREAD_PERF << " emits/thread)" << std::endl;
+  std::cout << "----------------------------------------" << std::endl;
+  bool all_correct = true;
+
+  for (int churners : {0, 1, 4}) {
+    const int emitters = 2;
+    EventEmitter emitter;
+    emitter.maxListeners = 1 << 20;
+    EventEmitter::EventId churn = emitter.id("churn");
+    std::atomic<long long> stable_calls(0);
+    for (int i = 0; i < CHURN_STABLE_LISTENERS_PERF; ++i) {
+      emitter.on(churn, [&](int) { stable_calls.fetch_add(1, std::memory_order_relaxed); });
+    }
+
+    std::atomic<bool> done(false);
+    std::atomic<long long> churn_pairs(0);
+    std::vector<std::thread> churn_threads;
+    for (int c = 0; c < churners; ++c) {
+      churn_threads.emplace_back([&]() {
+        long long pairs = 0;
+        while (!done.load(std::memory_order_relaxed)) {
+          auto subscription = emitter.on(churn, [](int) {});
+          subscription.unsubscribe();
+          pairs++;
+        }
+        churn_pairs += pairs;
+      });
+    }
+
+    std::vector<std::thread> emit_threads;
+    auto start_time = std::chrono::high_resolution_clock::now();
+    for (int e = 0; e < emitters; ++e) {
+      emit_threads.emplace_back([&]() {
+        for (int i = 0; i < CHURN_EMITS_PER_THREAD_PERF; ++i) {
+          emitter.emit(churn, i);
+        }
+      });
+    }
+    for (std::thread& t : emit_threads) {
+      t.join();
+    }
+    auto end_time = std::chrono::high_resolution_clock::now();
+    done = true;
+    for (std::thread& t : churn_threads) {
+      t.join();
+    }
+    std::chrono::duration<double> duration_s = end_time - start_time;
+
+    long long emits = (long long)emitters * CHURN_EMITS_PER_THREAD_PERF;
+    all_correct = all_correct && stable_calls.load() == emits * CHURN_STABLE_LISTENERS_PERF;
+
+    std::cout << "Churn threads: " << churners
+              << "  emits/sec: " << std::setw(14) << emits / duration_s.count()
+              << "  subscribe+unsubscribe/sec: " << std::setw(14) << churn_pairs.load() / duration_s.count()
+              << std::endl;
+    perf_record("subscription_churn")
+      .param("churn_threads", churners)
+      .metric("emits_per_sec", emits / duration_s.count())
+      .metric("churn_per_sec", churn_pairs.load() / duration_s.count());
+  }
+  std::cout << "----------------------------------------" << std::endl;
+  return all_correct;
+}
+
+const int ONCE_ROUNDS_PER_THREAD_PERF = 100000;
+
+// Every round registers a once listener and emits it, alongside 8 regular
+// listeners, so the cost of firing and retiring once listeners dominates.
+// Returns false if a once listener fired zero or several times.
+bool perf_once_heavy() {
+  std::cout << "Once-heavy (" << ONCE_ROUNDS_PER_THREAD_PERF << " once+emit rounds/thread, 8 regular listeners)" << std::endl;
+  std::cout << "----------------------------------------" << std::endl;
+  bool all_correct = true;
+
+  for (bool shared_event : {false, true}) {
+    for (int num_threads : {1, 4}) {
+      EventEmitter emitter;
+      emitter.maxListeners = 1 << 20;
+      std::vector<EventEmitter::EventId> ids;
+      for (int t = 0; t < num_threads; ++t) {
+        ids.push_back(emitter.id(shared_event ? "once_shared" : "once_" + std::to_string(t)));
+        for (int i = 0; i < 8 && (t == 0 || !shared_event); ++i) {
+          emitter.on(ids.back(), []() {});
+        }
+      }
+
+      std::atomic<long long> once_calls(0);
+      std::vector<std::thread> threads;
+      auto start_time = std::chrono::high_resolution_clock::now();
+      for (int t = 0; t < num_threads; ++t) {
+        threads.emplace_back([&, t]() {
+          for (int i = 0; i < ONCE_ROUNDS_PER_THREAD_PERF; ++i) {
+            emitter.once(ids[t], [&]() { once_calls.fetch_add(1, std::memory_order_relaxed); });
+            emitter.emit(ids[t]);
+          }
+        });
+      }
+      for (std::thread& t : threads) {
+        t.join();
+      }
+      auto end_time = std::chrono::high_resolution_clock::now();
+      std::chrono::duration<double> duration_s = end_time - start_time;
+
+      long long rounds = (long long)num_threads * ONCE_ROUNDS_PER_THREAD_PERF;
+      // On a shared event an emit can fire another thread's once listener,
+      // but every one of them still fires exactly once.
+      all_correct = all_correct && once_calls.load() == rounds && emitter.listeners() == (shared_event ? 8 : 8 * num_threads);
+
+      std::cout << (shared_event ? "shared event    " : "event per thread")
+                << "  threads: " << num_threads
+                << "  rounds/sec: " << std::setw(14) << rounds / duration_s.count()
+                << std::endl;
+      perf_record("once_heavy")
+        .param("names", shared_event ? "shared" : "disjoint")
+        .param("threads", num_threads)
+        .metric("rounds_per_sec", rounds / duration_s.count());
+    }
+  }
+  std::cout << "----------------------------------------" << std::endl;
+  return all_correct;
+}
+
+const int SHARD_ROUNDS_PER_THREAD_PERF = 50000;
+
+// Each round subscribes a listener, emits four times and unsubscribes, so
+// both the writer locks and the emit path are exercised. With disjoint
+// names every thread works on its own event; with a shared name they all
+// work on one.
+void perf_sharded_events() {
+  static std::atomic<long long> sink(0);
+  std::cout << "Disjoint vs shared event names (" << SHARD_ROUNDS_PER_THREAD_PERF
+            << " on+4 emits+unsubscribe rounds/thread)" << std::endl;
+  std::cout << "----------------------------------------" << std::endl;
+
+  for (bool shared_name : {false, true}) {
+    for (int num_threads : {1, 2, 4, 8}) {
+      EventEmitter emitter;
+      emitter.maxListeners = 1 << 20;
+      std::vector<EventEmitter::EventId> ids;
+      for (int t = 0; t < num_threads; ++t) {
+        ids.push_back(emitter.id(shared_name ? "shard_shared" : "shard_event_" + std::to_string(t)));
+      }
+
+      std::vector<std::thread> threads;
+      auto start_time = std::chrono::high_resolution_clock::now();
+      for (int t = 0; t < num_threads; ++t) {
+        threads.emplace_back([&, t]() {
+          for (int i = 0; i < SHARD_ROUNDS_PER_THREAD_PERF; ++i) {
+            auto subscription = emitter.on(ids[t], [](int v) { sink.fetch_add(v, std::memory_order_relaxed); });
+            for (int e = 0; e < 4; ++e) {
+              emitter.emit(ids[t], e);
+            }
+            subscription.unsubscribe();
+          }
+        });
+      }
+      for (std::thread& t : threads) {
+        t.join();
+      }
+      auto end_time = std::chrono::high_resolution_clock::now();
+      std::chrono::duration<double> duration_s = end_time - start_time;
+
+      long long rounds = (long long)num_threads * SHARD_ROUNDS_PER_THREAD_PERF;
+      std::cout << (shared_name ? "shared name   " : "disjoint names")
+                << "  threads: " << num_threads
+                << "  rounds/sec: " << std::setw(14) << rounds / duration_s.count()
+                << "  rounds/sec/thread: " << std::setw(14) << rounds / duration_s.count() / num_threads
+                << std::endl;
+      perf_record("sharded_events")
+        .param("names", shared_name ? "shared" : "disjoint")
+        .param("threads", num_threads)
+        .metric("rounds_per_sec", rounds / duration_s.count());
+    }
+  }
+  std::cout << "----------------------------------------" << std::endl;
+}
+
+const int WILDCARD_EMITS_PERF = 200000;
+const int WILDCARD_NEW_NAMES_PERF = 2000;
+const int WILDCARD_REPEATED_NAMES_PERF = 500;
+
+// Emits to a name matched by one pattern while more and more patterns that
+// do not match it are registered. Patterns are resolved when a name is first
+// seen, so ns/emit should not grow with the pattern count; the cost shows up
+// once per new name instead. Names no pattern matches are not interned, and
+// only pay that cost again once they fall out of the unmatched-name cache.
+void perf_wildcard_routing() {
+  std::cout << "Wildcard routing (1 exact + 1 matching pattern, " << WILDCARD_EMITS_PERF << " emits)" << std::endl;
+  std::cout << "----------------------------------------" << std::endl;
+
+  for (int patterns : {0, 16, 256}) {
+    EventEmitter emitter;
+    emitter.maxListeners = patterns + 100;
+    long long sink = 0;
+    emitter.on("order.fill.NYSE", [&](int value) { sink += value; });
+    emitter.on("order.**", [&](int value) { sink += value; });
+    for (int i = 0; i < patterns; ++i) {
+      emitter.on("venue" + std::to_string(i) + ".*.**", [&](int value) { sink -= value; });
+    }
+
+    const std::string name = "order.fill.NYSE";
+    auto start_time = std::chrono::high_resolution_clock::now();
+    for (int i = 0; i < WILDCARD_EMITS_PERF; ++i) {
+      emitter.emit(name, i);
+    }
+    auto end_time = std::chrono::high_resolution_clock::now();
+    std::chrono::duration<double, std::nano> emit_ns = end_time - start_time;
+
+    std::vector<std::string> new_names;
+    for (int i = 0; i < WILDCARD_NEW_NAMES_PERF; ++i) {
+      new_names.push_back("order.new." + std::to_string(i));
+    }
+    start_time = std::chrono::high_resolution_clock::now();
+    for (const std::string& new_name : new_names) {
+      emitter.emit(new_name, 1);
+    }
+    end_time = std::chrono::high_resolution_clock::now();
+    std::chrono::duration<double, std::nano> resolve_ns = end_time - start_time;
+
+    std::vector<std::string> unmatched_names;
+    for (int i = 0; i < WILDCARD_NEW_NAMES_PERF; ++i) {
+      unmatched_names.push_back("request." + std::to_string(i));
+    }
+    start_time = std::chrono::high_resolution_clock::now();
+    for (const std::string& unmatched_name : unmatched_names) {
+      emitter.emit(unmatched_name, 1);
+    }
+    end_time = std::chrono::high_resolution_clock::now();
+    std::chrono::duration<double, std::nano> unmatched_ns = end_time - start_time;
+
+    // The same unmatched names coming back, which the emitter remembers.
+    start_time = std::chrono::high_resolution_clock::now();
+    for (int i = 0; i < WILDCARD_EMITS_PERF; ++i) {
+      emitter.emit(unmatched_names[i % WILDCARD_REPEATED_NAMES_PERF], 1);
+    }
+    end_time = std::chrono::high_resolution_clock::now();
+    std::chrono::duration<double, std::nano> repeated_ns = end_time - start_time;
+
+    std::cout << "patterns: " << std::setw(4) << patterns
+              << "  ns/emit: " << std::setw(8) << emit_ns.count() / WILDCARD_EMITS_PERF
+              << "  ns/first emit of a new name: " << std::setw(10) << resolve_ns.count() / WILDCARD_NEW_NAMES_PERF
+              << "  ns/emit of an unmatched new name: " << std::setw(10) << unmatched_ns.count() / WILDCARD_NEW_NAMES_PERF
+              << "  ns/emit of a repeated unmatched name: " << std::setw(8) << repeated_ns.count() / WILDCARD_EMITS_PERF
+              << std::endl;
+    perf_record("wildcard_routing")
+      .param("patterns", patterns)
+      .metric("ns_per_emit", emit_ns.count() / WILDCARD_EMITS_PERF)
+      .metric("ns_per_new_name", resolve_ns.count() / WILDCARD_NEW_NAMES_PERF)
+      .metric("ns_per_unmatched_name", unmatched_ns.count() / WILDCARD_NEW_NAMES_PERF)
+      .metric("ns_per_repeated_unmatched_name", repeated_ns.count() / WILDCARD_EMITS_PERF);
+    if (sink == 0) std::cout << "(no callbacks ran)" << std::endl;
+  }
+  std::cout << "----------------------------------------" << std::endl;
+}
+
+const int STOP_EMITS_PERF = 200000;
+const int STOP_DOWNSTREAM_LISTENERS_PERF = 8;
+
+// Compares emitting to a list of void listeners with the same list behind a
+// high-priority filter that stops propagation for most messages.
+void perf_early_stop() {
+  static std::atomic<long long> sink(0);
+  std::cout << "Early stop (" << STOP_DOWNSTREAM_LISTENERS_PERF << " downstream listeners, "
+            << STOP_EMITS_PERF << " emits)" << std::endl;
+  std::cout << "----------------------------------------" << std::endl;
+
+  for (int rejected_percent : {-1, 0, 90}) {
+    EventEmitter emitter;
+    for (int i = 0; i < STOP_DOWNSTREAM_LISTENERS_PERF; ++i) {
+      emitter.on("stop_event", [](int value) { sink.fetch_add(value, std::memory_order_relaxed); });
+    }
+    if (rejected_percent >= 0) {
+      emitter.on("stop_event", [rejected_percent](int value) {
+        return value % 100 < rejected_percent ? EventEmitter::Propagation::Stop : EventEmitter::Propagation::Continue;
+      }, 1);
+    }
+
+    auto start_time = std::chrono::high_resolution_clock::now();
+    for (int i = 0; i < STOP_EMITS_PERF; ++i) {
+      emitter.emit("stop_event", i);
+    }
+    auto end_time = std::chrono::high_resolution_clock::now();
+    std::chrono::duration<double, std::nano> duration_ns = end_time - start_time;
+
+    std::string label = rejected_percent < 0 ? "no filter" : "filter rejects " + std::to_string(rejected_percent) + "%";
+    std::cout << std::left << std::setw(22) << label << std::right
+              << "ns/emit: " << std::setw(8) << duration_ns.count() / STOP_EMITS_PERF << std::endl;
+    perf_record("early_stop")
+      .param("filter", label)
+      .metric("ns_per_emit", duration_ns.count() / STOP_EMITS_PERF);
+  }
+  std::cout << "----------------------------------------" << std::endl;
+}
+
+// Fire-and-forget coroutine for perf_coroutine_waiters.
+struct PerfDetached {
+  struct promise_type {
+    PerfDetached get_return_object() { return {}; }
+    std::suspend_never initial_suspend() noexcept { return {}; }
+    std::suspend_never final_suspend() noexcept { return {}; }
+    void return_void() {}
+    void unhandled_exception() { std::terminate(); }
+  };
+};
+
+PerfDetached perf_wait_for_tick(EventEmitter& emitter, std::atomic<long long>& sink) {
+  int value = co_await emitter.next<int>("tick");
+  sink.fetch_add(value, std::memory_order_relaxed);
+}
+
+// Time to suspend N coroutines in next() and resume them all with one
+// emit, per waiter. Frame allocation is included in the suspend side.
+void perf_coroutine_waiters() {
+  static std::atomic<long long> sink(0);
+  std::cout << "Coroutine waiters (co_await next<int>)" << std::endl;
+  std::cout << "----------------------------------------" << std::endl;
+
+  for (int waiters : {100, 10000, 100000}) {
+    EventEmitter emitter;
+    emitter.id("tick");
+
+    auto start_time = std::chrono::high_resolution_clock::now();
+    for (int i = 0; i < waiters; ++i) {
+      perf_wait_for_tick(emitter, sink);
+    }
+    auto suspended_time = std::chrono::high_resolution_clock::now();
+    emitter.emit("tick", 1);
+    auto end_time = std::chrono::high_resolution_clock::now();
+
+    std::chrono::duration<double, std::nano> suspend_ns = suspended_time - start_time;
+    std::chrono::duration<double, std::nano> resume_ns = end_time - suspended_time;
+    std::cout << std::left << std::setw(8) << waiters << std::right
+              << "ns/suspend: " << std::setw(8) << suspend_ns.count() / waiters
+              << "  ns/resume: " << std::setw(8) << resume_ns.count() / waiters << std::endl;
+    perf_record("coroutine_waiters")
+      .param("waiters", waiters)
+      .metric("ns_per_suspend", suspend_ns.count() / waiters)
+      .metric("ns_per_resume", resume_ns.count() / waiters);
+  }
+  std::cout << "----------------------------------------" << std::endl;
+}
+
+#if defined(__linux__)  // SharedMemoryEmitter is Linux only.
+const int SHM_EMITS_PER_PRODUCER_PERF = 500000;
+const int SHM_PACED_EMITS_PERF = 20000;
+const int SHM_PACE_NS_PERF = 5000;
+
+// Producer processes publish timestamps on a SharedMemoryEmitter and this
+// process records how long each took to arrive; steady_clock is shared by
+// every process on the host. "flood" emits back to back for throughput,
+// "paced" leaves a gap between emits so latency is not queueing delay.
+void perf_shared_memory() {
+  std::cout << "SharedMemoryEmitter across processes (capacity 4096)" << std::endl;
+  std::cout << "----------------------------------------" << std::endl;
+  std::string name = "/eventemitter-perf-" + std::to_string(getpid());
+
+  struct Case { const char* mode; int producers; int emits; long long pace_ns; };
+  for (Case c : {Case{"flood", 1, SHM_EMITS_PER_PRODUCER_PERF, 0},
+                 Case{"flood", 2, SHM_EMITS_PER_PRODUCER_PERF, 0},
+                 Case{"paced", 1, SHM_PACED_EMITS_PERF, SHM_PACE_NS_PERF}}) {
+    SharedMemoryEmitter::unlink(name);
+    SharedMemoryEmitter bus(name);
+    const int total = c.producers * c.emits;
+    std::vector<long long> latency(total);
+    std::atomic<int> received(0);
+    std::atomic<int> ready(0);
+    bus.on("shm_ready", [&]() { ready++; });
+    bus.on("shm_event", [&](long long sent_ns) {
+      // Only the receiver thread writes.
+      int i = received.load(std::memory_order_relaxed);
+      latency[i] = perf_now_ns() - sent_ns;
+      received.store(i + 1, std::memory_order_release);
+    });
+
+    std::vector<pid_t> children;
+    for (int p = 0; p < c.producers; ++p) {
+      pid_t pid = fork();
+      if (pid == 0) {
+        {
+          SharedMemoryEmitter producer(name);
+          std::atomic<bool> go(false);
+          producer.on("shm_go", [&]() { go = true; });
+          producer.emit("shm_ready");
+          while (!go.load()) std::this_thread::yield();
+          for (int i = 0; i < c.emits; ++i) {
+            long long now = perf_now_ns();
+            producer.emit("shm_event", now);
+            if (c.pace_ns > 0) {
+              while (perf_now_ns() - now < c.pace_ns) std::this_thread::yield();
+            }
+          }
+        }
+        _exit(0);
+      }
+      children.push_back(pid);
+    }
+
+    while (ready.load() < c.producers) std::this_thread::yield();
+    long long start_ns = perf_now_ns();
+    bus.emit("shm_go");
+    while (received.load(std::memory_order_acquire) < total) std::this_thread::yield();
+    double duration_s = double(perf_now_ns() - start_ns) / 1e9;
+    for (pid_t pid : children) {
+      waitpid(pid, nullptr, 0);
+    }
+
+    std::cout << std::left << std::setw(6) << c.mode << std::right
+              << " producers: " << c.producers
+              << "  events/sec: " << std::setw(12) << total / duration_s
+              << "  latency ns p50/p99/p999: " << perf_percentile(latency, 50)
+              << "/" << perf_percentile(latency, 99) << "/" << perf_percentile(latency, 99.9) << std::endl;
+    perf_record("shared_memory")
+      .param("mode", c.mode)
+      .param("producers", c.producers)
+      .metric("events_per_sec", total / duration_s)
+      .metric("p50_ns", perf_percentile(latency, 50))
+      .metric("p99_ns", perf_percentile(latency, 99))
+      .metric("p999_ns", perf_percentile(latency, 99.9));
+  }
+  SharedMemoryEmitter::unlink(name);
+  std::cout << "----------------------------------------" << std::endl;
+}
+#endif
+
+const int RECORD_EMITS_PERF = 1000000;
+
+// ns/emit with one listener, unrecorded and with an EventRecorder attached,
+// for a trivially copyable argument and a serialized one. The log goes to
+// /tmp and is removed afterwards.
+void perf_recording() {
+  std::cout << "Recording emits (" << RECORD_EMITS_PERF << " emits)" << std::endl;
+  std::cout << "----------------------------------------" << std::endl;
+  std::string path = "/tmp/eventemitter-perf-" + std::to_string(getpid()) + ".evlog";
+  static std::atomic<long long> sink(0);
+
+  // "coarse" is the default clock, "ticks" is EventRecorder::Clock::Ticks.
+  auto run = [&](const char* args, const std::string& recording, auto&& emit_once) {
+    EventEmitter emitter;
+    emitter.on("tick", [](int v) { sink.fetch_add(v, std::memory_order_relaxed); });
+    emitter.on("text", [](const std::string& s) { sink.fetch_add(s.size(), std::memory_order_relaxed); });
+    std::unique_ptr<EventRecorder> recorder;
+    if (recording != "off") {
+      recorder = std::make_unique<EventRecorder>(path, 64 * 1024,
+        recording == "coarse" ? EventRecorder::Clock::Coarse : EventRecorder::Clock::Ticks);
+      emitter.record(recorder.get());
+    }
+    auto start_time = std::chrono::high_resolution_clock::now();
+    for (int i = 0; i < RECORD_EMITS_PERF; ++i) {
+      emit_once(emitter, i);
+    }
+    auto end_time = std::chrono::high_resolution_clock::now();
+    emitter.record(nullptr);
+    recorder.reset();
+
+    std::chrono::duration<double, std::nano> duration_ns = end_time - start_time;
+    double ns_per_emit = duration_ns.count() / RECORD_EMITS_PERF;
+    std::cout << std::left << std::setw(8) << args << std::setw(12) << recording
+              << std::right << "ns/emit: " << std::setw(8) << ns_per_emit << std::endl;
+    perf_record("record")
+      .param("args", args)
+      .param("recording", recording)
+      .metric("ns_per_emit", ns_per_emit);
+    return ns_per_emit;
+  };
+
+  const std::string text = "order-filled";
+  for (const char* recording : {"off", "ticks", "coarse"}) {
+    run("int", recording, [](EventEmitter& emitter, int i) { emitter.emit("tick", i); });
+  }
+  for (const char* recording : {"off", "ticks", "coarse"}) {
+    run("string", recording, [&](EventEmitter& emitter, int) { emitter.emit("text", text); });
+  }
+  std::remove(path.c_str());
+  std::cout << "----------------------------------------" << std::endl;
+}
+
+const int EXECUTOR_EMITS_PERF = 500000;
+const int EXECUTOR_PACED_EMITS_PERF = 20000;
+const int EXECUTOR_PACE_NS_PERF = 5000;
+
+// Emit-to-callback latency and throughput for a listener that must run on
+// a loop thread other than the emitting one. "inline" calls it on the
+// emitting thread, as the floor. "mutex_queue" is the hand-rolled way: the
+// listener posts a std::function to the loop's locked queue. "executor"
+// binds the listener to an EventEmitter::Executor the loop polls.
+void perf_executor_delivery() {
+  std::cout << "Executor-bound listeners (cross-thread delivery)" << std::endl;
+  std::cout << "----------------------------------------" << std::endl;
+
+  struct Case { const char* mode; const char* load; int emits; long long pace_ns; };
+  for (const char* mode : {"inline", "mutex_queue", "executor"}) {
+    for (Case c : {Case{mode, "flood", EXECUTOR_EMITS_PERF, 0},
+                   Case{mode, "paced", EXECUTOR_PACED_EMITS_PERF, EXECUTOR_PACE_NS_PERF}}) {
+      EventEmitter emitter;
+      EventEmitter::Executor executor;
+      std::mutex queue_mutex;
+      std::deque<std::function<void()>> queue;
+      std::vector<long long> latency(c.emits);
+      std::atomic<int> received(0);
+      std::atomic<bool> stop(false);
+
+      auto arrived = [&](long long sent_ns) {
+        int i = received.load(std::memory_order_relaxed);
+        latency[i] = perf_now_ns() - sent_ns;
+        received.store(i + 1, std::memory_order_release);
+      };
+      std::string mode_name = c.mode;
+      if (mode_name == "inline") {
+        emitter.on("deliver", [&](long long sent_ns) { arrived(sent_ns); });
+      } else if (mode_name == "mutex_queue") {
+        emitter.on("deliver", [&](long long sent_ns) {
+          std::lock_guard<std::mutex> lock(queue_mutex);
+          queue.push_back([&arrived, sent_ns]() { arrived(sent_ns); });
+        });
+      } else {
+        emitter.on("deliver", [&](long long sent_ns) { arrived(sent_ns); }, executor);
+      }
+
+      std::thread loop([&]() {
+        while (!stop.load(std::memory_order_relaxed)) {
+          std::size_t ran = 0;
+          if (mode_name == "mutex_queue") {
+            std::deque<std::function<void()>> batch;
+            {
+              std::lock_guard<std::mutex> lock(queue_mutex);
+              batch.swap(queue);
+            }
+            for (auto& task : batch) task();
+            ran = batch.size();
+          } else if (mode_name == "executor") {
+            ran = executor.poll();
+          }
+          if (ran == 0) std::this_thread::yield();
+        }
+      });
+
+      long long start_ns = perf_now_ns();
+      for (int i = 0; i < c.emits; ++i) {
+        long long now = perf_now_ns();
+        emitter.emit("deliver", now);
+        if (c.pace_ns > 0) {
+          while (perf_now_ns() - now < c.pace_ns) std::this_thread::yield();
+        }
+      }
+      while (received.load(std::memory_order_acquire) < c.emits) std::this_thread::yield();
+      double duration_s = double(perf_now_ns() - start_ns) / 1e9;
+      stop = true;
+      loop.join();
+
+      std::cout << std::left << std::setw(12) << c.mode << std::setw(6) << c.load << std::right
+                << "  events/sec: " << std::setw(12) << c.emits / duration_s
+                << "  latency ns p50/p99: " << perf_percentile(latency, 50)
+                << "/" << perf_percentile(latency, 99) << std::endl;
+      perf_record("executor_delivery")
+        .param("mode", c.mode)
+        .param("load", c.load)
+        .metric("events_per_sec", c.emits / duration_s)
+        .metric("p50_ns", perf_percentile(latency, 50))
+        .metric("p99_ns", perf_percentile(latency, 99));
+    }
+  }
+  std::cout << "----------------------------------------" << std::endl;
+}
+
+// Runs the perf_worker workload at increasing thread counts so the scaling
+// curve of the emit path is visible. Returns false if any run lost callbacks.
+bool perf_thread_scaling() {
+  std::cout << "Thread scaling (" << LISTENERS_PER_THREAD_PERF << " events/thread, "
+            << EMITS_PER_THREAD_PERF << " emits/event)" << std::endl;
+  std::cout << "----------------------------------------" << std::endl;
+  bool all_correct = true;
+
+  for (int num_threads : {1, 2, 4, 8, 16, 32}) {
+    EventEmitter emitter;
+    emitter.maxListeners = num_threads * LISTENERS_PER_THREAD_PERF + 100;
+    perf_callback_counter = 0;
+
+    std::vector<std::thread> threads;
+    auto start_time = std::chrono::high_resolution_clock::now();
+
+    for (int i = 0; i < num_threads; ++i) {
+      threads.emplace_back(perf_worker, std::ref(emitter), i);
+    }
+    for (std::thread& t : threads) {
+      t.join();
+    }
+
+    auto end_time = std::chrono::high_resolution_clock::now();
+    std::chrono::duration<double> duration_s = end_time - start_time;
+
+    long long expected_callbacks = (long long)num_threads * LISTENERS_PER_THREAD_PERF * EMITS_PER_THREAD_PERF;
+    all_correct = all_correct && perf_callback_counter.load() == expected_callbacks;
+
+    std::cout << "Threads: " << std::setw(2) << num_threads
+              << "  emits/sec: " << std::setw(14) << expected_callbacks / duration_s.count()
+              << "  emits/sec/thread: " << std::setw(14) << expected_callbacks / duration_s.count() / num_threads
+              << std::endl;
+    perf_record("thread_scaling")
+      .param("threads", num_threads)
+      .metric("emits_per_sec", expected_callbacks / duration_s.count());
+  }
+  std::cout << "----------------------------------------" << std::endl;
+  return all_correct;
+}
+
+//
+// Usage: perf_runner [--json FILE]
+// With --json, every scenario's results are also written to FILE ("-" for
+// stdout) as {"format": 1, "records": [{"scenario", "params", "metrics"}]}.
+//
+int main(int argc, char** argv) {
+  const char* json_path = nullptr;
+  for (int i = 1; i < argc; ++i) {
+    if (std::strcmp(argv[i], "--json") == 0 && i + 1 < argc) {
+      json_path = argv[++i];
+    } else {
+      std::cerr << "Usage: " << argv[0] << " [--json FILE]" << std::endl;
+      return 2;
+    }
+  }
+
+  std::cout << std::fixed << std::setprecision(2);
+  perf_emit_matrix();
+  perf_allocations_per_emit();
+  perf_registration_allocations();
+  perf_large_payloads();
+  perf_name_resolution();
+  perf_batched_emit();
+  perf_async_emit();
+
+  perf_sharded_events();
+  perf_wildcard_routing();
+  perf_early_stop();
+  perf_coroutine_waiters();
+#if defined(__linux__)
+  perf_shared_memory();
+#endif
+  perf_recording();
+  perf_executor_delivery();
+
+  if (!perf_once_heavy()) {
+    std::cerr << "Error: once listeners did not fire exactly once" << std::endl;
+    return 1;
+  }
+
+  if (!perf_subscription_churn()) {
+    std::cerr << "Error: churn run lost callbacks" << std::endl;
+    return 1;
+  }
+
+  if (!perf_thread_scaling()) {
+    std::cerr << "Error: thread scaling run lost callbacks" << std::endl;
+    return 1;
+  }
+
   std::cout << "Starting Performance Test..." << std::endl;
 
   EventEmitter perf_emitter;
@@ -91,6 +1350,24 @@ int main() {
   }
   std::cout << "----------------------------------------" << std::endl;
 
+  perf_record("baseline")
+    .param("threads", NUM_PERF_THREADS)
+    .param("listeners_per_thread", LISTENERS_PER_THREAD_PERF)
+    .metric("emits_per_sec", duration_seconds > 0 ? expected_callbacks / duration_seconds : 0);
+
+  if (json_path != nullptr) {
+    if (std::strcmp(json_path, "-") == 0) {
+      perf_write_json(std::cout);
+    } else {
+      std::ofstream json_file(json_path);
+      perf_write_json(json_file);
+      if (!json_file) {
+        std::cerr << "Error: could not write " << json_path << std::endl;
+        return 1;
+      }
+    }
+  }
+
   if (actual_callbacks == expected_callbacks) {
     std::cout << "Callback count: CORRECT" << std::endl;
   } else {
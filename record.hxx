@@ -0,0 +1,466 @@
+#ifndef __EVENTS_RECORD_H_
+#define __EVENTS_RECORD_H_
+
+#include "index.hxx"
+
+#include <cerrno>
+#include <cstdio>
+#include <cstring>
+#include <stdexcept>
+#include <string>
+#include <system_error>
+#include <unordered_map>
+#include <unordered_set>
+
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <time.h>
+#include <unistd.h>
+
+#if defined(__x86_64__) || defined(__i386__)
+#include <x86intrin.h>
+#endif
+
+//
+// Maps argument fingerprints to the function that emits them again. An
+// EventRecorder adds each signature the first time it records it, and
+// EventReplay::accept adds others, so programs that never record pay
+// nothing for it.
+//
+class EventCodecs {
+  static std::unordered_map<std::uint64_t, EventEmitter::ReplayFn>& table() {
+    static std::unordered_map<std::uint64_t, EventEmitter::ReplayFn> codecs;
+    return codecs;
+  }
+
+  static std::mutex& mutex() {
+    static std::mutex mtx;
+    return mtx;
+  }
+
+public:
+  static void add(std::uint64_t fingerprint, EventEmitter::ReplayFn replay) {
+    std::lock_guard<std::mutex> lock(mutex());
+    table().emplace(fingerprint, replay);
+  }
+
+  static EventEmitter::ReplayFn find(std::uint64_t fingerprint) {
+    std::lock_guard<std::mutex> lock(mutex());
+    auto it = table().find(fingerprint);
+    return it == table().end() ? nullptr : it->second;
+  }
+};
+
+//
+// Writes every emit of the emitters it is attached to into a compact
+// binary log, e.g.
+//
+//   EventRecorder recorder("session.evlog");
+//   emitter.record(&recorder);
+//   ...
+//   emitter.record(nullptr);
+//
+// Each thread appends to its own buffer, and a full buffer is written to
+// the file as one chunk, so recording takes no lock per emit. Arguments
+// are recorded byte for byte if they are trivially copyable and not
+// pointers, or through their EventSerializer; emits with any other
+// argument are counted by skipped() and left out. POSIX only.
+//
+// Records are stamped with the kernel's coarse clock by default, the
+// cheapest clock there is, which only resolves a few milliseconds.
+// Clock::Ticks stamps with the CPU's tick counter (the TSC on x86, the
+// virtual counter on arm64) for precise gaps; the clock is read once per
+// chunk, and EventReplay converts ticks to time with the rate between the
+// first and the last reading. This assumes the counter runs at a constant
+// rate and in step on every core, as on any x86 host with an invariant TSC.
+// It is slower to read than the coarse clock in some virtual machines.
+//
+// Log layout: the 8-byte magic and the u64 ticks at start, then chunks of
+// `[u32 record bytes][u64 ns since start][u64 ticks at that time][records]`,
+// each record `[u64 ticks][u64 fingerprint][u32 argument bytes]
+// [u16 name bytes][name][arguments]`, in native byte order.
+//
+class EventRecorder : public EventEmitter::EmitTap {
+public:
+  enum class Clock {
+    Ticks,   // CPU tick counter: precise.
+    Coarse,  // CLOCK_MONOTONIC_COARSE where available: cheapest, millisecond resolution. The default.
+  };
+
+private:
+  static constexpr std::size_t RECORD_HEADER = 8 + 8 + 4 + 2;
+
+  struct ThreadBuffer {
+    std::thread::id owner;
+    std::vector<std::byte> bytes;
+    std::size_t used = 0;
+    std::uint64_t last_fingerprint = 0;
+    std::unordered_set<std::uint64_t> fingerprints;  // Signatures this thread has added to EventCodecs.
+  };
+
+  //
+  // The last buffer each thread used, so a tap finds its own without a
+  // lock. Recorder ids are never reused, so a stale entry never matches.
+  //
+  struct BufferCache {
+    std::uint64_t recorder = 0;
+    ThreadBuffer* buffer = nullptr;
+  };
+
+  static std::uint64_t next_id() {
+    static std::atomic<std::uint64_t> ids{1};
+    return ids.fetch_add(1, std::memory_order_relaxed);
+  }
+
+  const std::uint64_t id_ = next_id();
+  const std::size_t buffer_bytes_;
+  const Clock clock_;
+  const std::chrono::steady_clock::time_point start_ = std::chrono::steady_clock::now();
+  const std::uint64_t start_ticks_ = ticks(clock_);
+  std::FILE* file_ = nullptr;
+  std::mutex mtx_;  // Guards buffers_ and file_.
+  std::vector<std::unique_ptr<ThreadBuffer>> buffers_;
+  std::atomic<std::size_t> skipped_{0};
+
+  ThreadBuffer& local_buffer() {
+    static thread_local BufferCache cache;
+    if (cache.recorder == id_) {
+      return *cache.buffer;
+    }
+    std::lock_guard<std::mutex> lock(mtx_);
+    auto self = std::this_thread::get_id();
+    auto it = std::find_if(buffers_.begin(), buffers_.end(), [&](const auto& b) {
+      return b->owner == self;
+    });
+    if (it == buffers_.end()) {
+      auto created = std::make_unique<ThreadBuffer>();
+      created->owner = self;
+      created->bytes.resize(buffer_bytes_);
+      it = buffers_.insert(buffers_.end(), std::move(created));
+    }
+    cache = {id_, it->get()};
+    return **it;
+  }
+
+  void write_chunk(const std::byte* data, std::size_t size) {
+    auto bytes = std::uint32_t(size);
+    auto time = std::uint64_t(std::chrono::duration_cast<std::chrono::nanoseconds>(
+      std::chrono::steady_clock::now() - start_).count());
+    auto now = ticks(clock_);
+    std::fwrite(&bytes, sizeof(bytes), 1, file_);
+    std::fwrite(&time, sizeof(time), 1, file_);
+    std::fwrite(&now, sizeof(now), 1, file_);
+    std::fwrite(data, 1, size, file_);
+  }
+
+  void write_chunk(ThreadBuffer& buffer) {
+    if (buffer.used == 0) {
+      return;
+    }
+    std::lock_guard<std::mutex> lock(mtx_);
+    write_chunk(buffer.bytes.data(), buffer.used);
+    buffer.used = 0;
+  }
+
+  static std::byte* put(std::byte* out, const void* value, std::size_t size) {
+    std::memcpy(out, value, size);
+    return out + size;
+  }
+
+public:
+  static constexpr std::uint64_t MAGIC = 0x3230304345525645ull;  // "EVREC002" on little-endian hosts.
+
+  static std::uint64_t ticks(Clock clock) {
+#if defined(CLOCK_MONOTONIC_COARSE)
+    if (clock == Clock::Coarse) {
+      timespec now;
+      ::clock_gettime(CLOCK_MONOTONIC_COARSE, &now);
+      return std::uint64_t(now.tv_sec) * 1000000000 + std::uint64_t(now.tv_nsec);
+    }
+#else
+    (void)clock;
+#endif
+#if defined(__x86_64__) || defined(__i386__)
+    return __rdtsc();
+#elif defined(__aarch64__)
+    std::uint64_t value;
+    asm volatile("mrs %0, cntvct_el0" : "=r"(value));
+    return value;
+#else
+    return std::uint64_t(std::chrono::steady_clock::now().time_since_epoch().count());
+#endif
+  }
+
+  explicit EventRecorder(const std::string& path, std::size_t buffer_bytes = 64 * 1024,
+                         Clock clock = Clock::Coarse)
+    : buffer_bytes_(buffer_bytes), clock_(clock) {
+    file_ = std::fopen(path.c_str(), "wb");
+    if (file_ == nullptr) {
+      throw std::system_error(errno, std::generic_category(), "fopen " + path);
+    }
+    std::fwrite(&MAGIC, sizeof(MAGIC), 1, file_);
+    std::fwrite(&start_ticks_, sizeof(start_ticks_), 1, file_);
+  }
+
+  EventRecorder(const EventRecorder&) = delete;
+  EventRecorder& operator=(const EventRecorder&) = delete;
+
+  //
+  // Detach the recorder from every emitter first.
+  //
+  ~EventRecorder() override {
+    flush();
+    std::fclose(file_);
+  }
+
+  void tap(std::string_view name, const EventEmitter::EmitPayload& payload) override {
+    if (payload.fingerprint == 0 || name.size() > UINT16_MAX) {
+      skipped_.fetch_add(1, std::memory_order_relaxed);
+      return;
+    }
+    auto time = ticks(clock_);
+    auto arguments = std::uint32_t(payload.size(payload.arguments));
+    auto name_length = std::uint16_t(name.size());
+    std::size_t size = RECORD_HEADER + name_length + arguments;
+
+    ThreadBuffer& buffer = local_buffer();
+    if (payload.fingerprint != buffer.last_fingerprint) {
+      if (buffer.fingerprints.insert(payload.fingerprint).second) {
+        EventCodecs::add(payload.fingerprint, payload.replay);
+      }
+      buffer.last_fingerprint = payload.fingerprint;
+    }
+    std::vector<std::byte> oversized;
+    std::byte* out;
+    if (size > buffer.bytes.size()) {
+      write_chunk(buffer);  // Keeps this thread's records in order.
+      oversized.resize(size);
+      out = oversized.data();
+    } else {
+      if (buffer.used + size > buffer.bytes.size()) {
+        write_chunk(buffer);
+      }
+      out = buffer.bytes.data() + buffer.used;
+      buffer.used += size;
+    }
+
+    out = put(out, &time, sizeof(time));
+    out = put(out, &payload.fingerprint, sizeof(payload.fingerprint));
+    out = put(out, &arguments, sizeof(arguments));
+    out = put(out, &name_length, sizeof(name_length));
+    out = put(out, name.data(), name_length);
+    payload.write(payload.arguments, out);
+
+    if (!oversized.empty()) {
+      std::lock_guard<std::mutex> lock(mtx_);
+      write_chunk(oversized.data(), oversized.size());
+    }
+  }
+
+  //
+  // Writes every thread's buffer to the file. Only while detached: a
+  // concurrent emit may be writing into its buffer otherwise.
+  //
+  void flush() {
+    std::lock_guard<std::mutex> lock(mtx_);
+    for (auto& buffer : buffers_) {
+      if (buffer->used != 0) {
+        write_chunk(buffer->bytes.data(), buffer->used);
+        buffer->used = 0;
+      }
+    }
+    std::fflush(file_);
+  }
+
+  //
+  // Emits that were not recorded because an argument has no serializer.
+  //
+  std::size_t skipped() const {
+    return skipped_.load(std::memory_order_relaxed);
+  }
+};
+
+//
+// Reads a log written by EventRecorder and emits it again, in the order the
+// events were originally emitted (by time; per thread, always in order).
+//
+//   EventReplay replay("session.evlog");
+//   replay.run(emitter, EventReplay::Timing::Original);
+//
+// Every signature the program itself has recorded can be decoded. A tool
+// that only replays logs must name the signatures it expects with accept().
+//
+class EventReplay {
+public:
+  enum class Timing {
+    FullSpeed,  // Emit back to back.
+    Original,   // Keep the recorded gaps between emits.
+  };
+
+private:
+  struct Entry {
+    std::uint64_t time;  // Ticks while parsing, then ns since the recording started.
+    std::uint64_t fingerprint;
+    std::string_view name;
+    const std::byte* arguments;
+    std::size_t size;
+  };
+
+  const std::byte* data_ = nullptr;
+  std::size_t size_ = 0;
+  std::vector<Entry> entries_;
+
+  template <typename T>
+  static T load(const std::byte* in) {
+    T value;
+    std::memcpy(&value, in, sizeof(T));
+    return value;
+  }
+
+  void parse(const std::string& path) {
+    constexpr std::size_t FILE_HEADER = 8 + 8;
+    constexpr std::size_t CHUNK_HEADER = 4 + 8 + 8;
+    if (size_ < FILE_HEADER || load<std::uint64_t>(data_) != EventRecorder::MAGIC) {
+      throw std::runtime_error("EventReplay: " + path + " is not an event log");
+    }
+    auto start_ticks = load<std::uint64_t>(data_ + 8);
+    std::uint64_t last_time = 0;
+    std::uint64_t last_ticks = start_ticks;
+    const std::byte* in = data_ + FILE_HEADER;
+    const std::byte* end = data_ + size_;
+    while (in != end) {
+      if (std::size_t(end - in) < CHUNK_HEADER ||
+          std::size_t(end - in) - CHUNK_HEADER < load<std::uint32_t>(in)) {
+        throw std::runtime_error("EventReplay: " + path + " is truncated");
+      }
+      const std::byte* chunk_end = in + CHUNK_HEADER + load<std::uint32_t>(in);
+      if (load<std::uint64_t>(in + 12) > last_ticks) {
+        last_time = load<std::uint64_t>(in + 4);
+        last_ticks = load<std::uint64_t>(in + 12);
+      }
+      in += CHUNK_HEADER;
+      while (in != chunk_end) {
+        if (std::size_t(chunk_end - in) < 22) {
+          throw std::runtime_error("EventReplay: " + path + " is corrupt");
+        }
+        Entry entry;
+        entry.time = load<std::uint64_t>(in);
+        entry.fingerprint = load<std::uint64_t>(in + 8);
+        auto arguments = load<std::uint32_t>(in + 16);
+        auto name_length = load<std::uint16_t>(in + 20);
+        in += 22;
+        if (std::size_t(chunk_end - in) < std::size_t(name_length) + arguments) {
+          throw std::runtime_error("EventReplay: " + path + " is corrupt");
+        }
+        entry.name = std::string_view(reinterpret_cast<const char*>(in), name_length);
+        entry.arguments = in + name_length;
+        entry.size = arguments;
+        in += name_length + arguments;
+        entries_.push_back(entry);
+      }
+    }
+    std::stable_sort(entries_.begin(), entries_.end(), [](const Entry& a, const Entry& b) {
+      return a.time < b.time;
+    });
+    double ns_per_tick = last_ticks > start_ticks ? double(last_time) / double(last_ticks - start_ticks) : 0;
+    for (Entry& entry : entries_) {
+      entry.time = entry.time > start_ticks ? std::uint64_t(double(entry.time - start_ticks) * ns_per_tick) : 0;
+    }
+  }
+
+public:
+  explicit EventReplay(const std::string& path) {
+    int fd = ::open(path.c_str(), O_RDONLY | O_CLOEXEC);
+    if (fd < 0) {
+      throw std::system_error(errno, std::generic_category(), "open " + path);
+    }
+    struct stat st;
+    if (::fstat(fd, &st) != 0) {
+      int error = errno;
+      ::close(fd);
+      throw std::system_error(error, std::generic_category(), "fstat " + path);
+    }
+    size_ = std::size_t(st.st_size);
+    if (size_ != 0) {
+      void* mapped = ::mmap(nullptr, size_, PROT_READ, MAP_PRIVATE, fd, 0);
+      if (mapped == MAP_FAILED) {
+        int error = errno;
+        ::close(fd);
+        throw std::system_error(error, std::generic_category(), "mmap " + path);
+      }
+      data_ = static_cast<const std::byte*>(mapped);
+    }
+    ::close(fd);
+
+    try {
+      parse(path);
+    } catch (...) {
+      if (data_ != nullptr) {
+        ::munmap(const_cast<std::byte*>(data_), size_);
+      }
+      throw;
+    }
+  }
+
+  EventReplay(const EventReplay&) = delete;
+  EventReplay& operator=(const EventReplay&) = delete;
+
+  ~EventReplay() {
+    if (data_ != nullptr) {
+      ::munmap(const_cast<std::byte*>(data_), size_);
+    }
+  }
+
+  //
+  // Lets run() decode emits of this signature, as `emit(name, Args...)`.
+  //
+  template <typename... Args>
+  static void accept() {
+    static_assert((EventEmitter::is_recordable<Args> && ...),
+      "Arguments must be trivially copyable and not pointers, or have an EventSerializer");
+    EventCodecs::add(EventEmitter::fingerprint<Args...>, &EventEmitter::ArgumentCodec<Args...>::replay);
+  }
+
+  std::size_t size() const {
+    return entries_.size();
+  }
+
+  //
+  // Emits every recorded event on `emitter`, from the calling thread, and
+  // returns how many were emitted. Events whose signature cannot be
+  // decoded, or whose argument bytes do not match it, are reported and
+  // skipped.
+  //
+  std::size_t run(EventEmitter& emitter, Timing timing = Timing::FullSpeed) const {
+    std::unordered_map<std::uint64_t, EventEmitter::ReplayFn> codecs;
+    auto start = std::chrono::steady_clock::now();
+    std::size_t emitted = 0;
+
+    for (const Entry& entry : entries_) {
+      auto it = codecs.find(entry.fingerprint);
+      if (it == codecs.end()) {
+        it = codecs.emplace(entry.fingerprint, EventCodecs::find(entry.fingerprint)).first;
+      }
+      if (it->second == nullptr) {
+        std::cerr << "Replay error for event '" << entry.name << "': "
+                  << "No decoder for its argument types."
+                  << std::endl;
+        continue;
+      }
+      if (timing == Timing::Original) {
+        std::this_thread::sleep_until(start + std::chrono::nanoseconds(entry.time - entries_.front().time));
+      }
+      if (!it->second(emitter, entry.name, entry.arguments, entry.size)) {
+        std::cerr << "Replay error for event '" << entry.name << "': "
+                  << "Corrupt arguments."
+                  << std::endl;
+        continue;
+      }
+      ++emitted;
+    }
+    return emitted;
+  }
+};
+
+#endif
@@ -0,0 +1,531 @@
+#ifndef __EVENTS_SHM_H_
+#define __EVENTS_SHM_H_
+
+#include "index.hxx"
+
+#if defined(__linux__)  // Elsewhere this header declares nothing.
+
+#include <bit>
+#include <cerrno>
+#include <climits>
+#include <cstring>
+#include <stdexcept>
+#include <string>
+#include <system_error>
+
+#include <fcntl.h>
+#include <signal.h>
+#include <linux/futex.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+
+//
+// An event bus shared by every process on the host that attaches to the
+// same name, e.g. `SharedMemoryEmitter bus("/orders");`. `on` and `emit`
+// work as on EventEmitter, but an emit is published to a ring buffer in
+// shared memory and every attached emitter, this one included, calls its
+// listeners from its own receiver thread, in publication order. Arguments
+// are copied into the ring byte for byte, so they must be trivially
+// copyable and must not be pointers; both are checked at compile time.
+// Linux only: the header is empty on other systems.
+//
+class SharedMemoryEmitter : private EventEmitter {
+public:
+  static constexpr std::size_t SLOT_BYTES = 256;
+  static constexpr std::size_t MAX_NAME = 36;      // Bytes of event name per emit.
+  static constexpr std::size_t MAX_PAYLOAD = 192;  // Bytes of arguments per emit.
+  static constexpr std::size_t MAX_READERS = 64;   // Emitters attached at once.
+
+  struct Options {
+    std::size_t capacity = 4096;  // Emits in the ring, rounded up to a power of two. The creator's value wins.
+    bool block_when_full = true;  // Otherwise emit returns false while the slowest reader is a full ring behind.
+  };
+
+private:
+  static constexpr std::uint64_t MAGIC = 0x45564e5453484d32ull;  // "EVNTSHM2"; changes with the layout.
+
+  //
+  // One per attached emitter. Producers never overwrite an emit that an
+  // active reader's cursor has not passed. `owner` is the attached
+  // process's pid, or 0 while the reader is free; a reader whose process
+  // has died is freed by the next producer it holds up.
+  //
+  struct alignas(64) Reader {
+    std::atomic<std::uint64_t> cursor{0};
+    std::atomic<std::int32_t> owner{0};
+  };
+
+  //
+  // A slot is published by storing `position + 1` into its sequence, after
+  // everything else has been written. Right after claiming it, the producer
+  // stores its pid and the low half of `position + 1` into `claim`, so
+  // readers can tell a producer that died before publishing from a slow one.
+  //
+  struct alignas(64) Slot {
+    std::atomic<std::uint64_t> sequence;
+    std::uint64_t fingerprint;
+    std::atomic<std::uint64_t> claim;
+    std::uint16_t name_length;
+    std::uint16_t payload_size;
+    char name[MAX_NAME];
+    alignas(64) std::byte payload[MAX_PAYLOAD];
+  };
+  static_assert(sizeof(Slot) == SLOT_BYTES);
+
+  struct Header {
+    std::atomic<std::uint64_t> magic;  // Stored last by the creator.
+    std::uint64_t capacity;
+    alignas(64) std::atomic<std::uint64_t> tail;  // Next position to claim.
+    alignas(64) std::atomic<std::uint32_t> signal;  // Futex word readers sleep on.
+    std::atomic<std::uint32_t> sleepers;
+    Reader readers[MAX_READERS];
+  };
+
+  static constexpr std::size_t SLOTS_OFFSET = (sizeof(Header) + 63) / 64 * 64;
+
+  static_assert(std::atomic<std::uint64_t>::is_always_lock_free && std::atomic<std::uint32_t>::is_always_lock_free,
+                "Atomics in shared memory must be lock-free to be address-free");
+
+  //
+  // An emit as seen by the local listeners. The payload points into the
+  // ring and is only valid during the call.
+  //
+  struct Record {
+    std::string_view name;
+    std::uint64_t fingerprint;
+    const std::byte* payload;
+  };
+
+  template <typename T>
+  static constexpr bool is_transportable = std::is_trivially_copyable_v<T> && !std::is_pointer_v<T> &&
+    !std::is_member_pointer_v<T> && alignof(T) <= 64;
+
+  //
+  // Where each argument lives in a slot's payload: packed in order, each at
+  // its own alignment.
+  //
+  template <typename... Args>
+  struct Layout {
+    static constexpr auto offsets = [] {
+      std::array<std::size_t, sizeof...(Args)> result{};
+      std::size_t offset = 0;
+      [[maybe_unused]] std::size_t i = 0;
+      ((offset = (offset + alignof(Args) - 1) / alignof(Args) * alignof(Args), result[i++] = offset, offset += sizeof(Args)), ...);
+      return result;
+    }();
+
+    static constexpr std::size_t size = [] {
+      std::size_t offset = 0;
+      ((offset = (offset + alignof(Args) - 1) / alignof(Args) * alignof(Args) + sizeof(Args)), ...);
+      return offset;
+    }();
+  };
+
+  template <typename T>
+  static T load(const std::byte* from) {
+    std::array<std::byte, sizeof(T)> bytes;
+    std::memcpy(bytes.data(), from, sizeof(T));
+    return std::bit_cast<T>(bytes);
+  }
+
+  template <typename... Args, typename Callback, std::size_t... I>
+  static decltype(auto) unpack(Callback&& cb, [[maybe_unused]] const std::byte* payload, std::index_sequence<I...>) {
+    return std::forward<Callback>(cb)(load<Args>(payload + Layout<Args...>::offsets[I])...);
+  }
+
+  //
+  // Wraps a listener so the local emitter can call it with a Record, which
+  // it checks and unpacks into the listener's own argument types.
+  //
+  template <typename Callback, typename... Args>
+  static auto make_receiver(Callback&& cb, std::tuple<Args...>*) {
+    static_assert((is_transportable<std::decay_t<Args>> && ...),
+                  "SharedMemoryEmitter listeners must take trivially copyable, non-pointer arguments");
+    static_assert(Layout<std::decay_t<Args>...>::size <= MAX_PAYLOAD,
+                  "SharedMemoryEmitter listener arguments do not fit in a slot");
+    using Result = std::conditional_t<
+      std::is_same_v<typename traits<std::decay_t<Callback>>::ReturnType, Propagation>, Propagation, void>;
+
+    return [cb = std::forward<Callback>(cb)](const Record& record) mutable -> Result {
+      if (record.fingerprint != fingerprint<std::decay_t<Args>...>) {
+        std::cerr << "Emit error for event '" << record.name << "': "
+                  << "Callback signature mismatch."
+                  << std::endl;
+        if constexpr (std::is_void_v<Result>) {
+          return;
+        } else {
+          return Propagation::Continue;
+        }
+      }
+      if constexpr (std::is_void_v<Result>) {
+        unpack<std::decay_t<Args>...>(cb, record.payload, std::index_sequence_for<Args...>());
+      } else {
+        return unpack<std::decay_t<Args>...>(cb, record.payload, std::index_sequence_for<Args...>());
+      }
+    };
+  }
+
+  template <typename Callback>
+  using arguments_t = typename traits<std::decay_t<Callback>>::ArgumentTypesAsTuple;
+
+  static constexpr timespec ABANDON_CHECK = {0, 50 * 1000 * 1000};
+
+  static void futex_wait(std::atomic<std::uint32_t>& word, std::uint32_t expected, const timespec* timeout = nullptr) {
+    // Not FUTEX_PRIVATE: the word is shared with other processes.
+    syscall(SYS_futex, reinterpret_cast<std::uint32_t*>(&word), FUTEX_WAIT, expected, timeout, nullptr, 0);
+  }
+
+  static void futex_wake_all(std::atomic<std::uint32_t>& word) {
+    syscall(SYS_futex, reinterpret_cast<std::uint32_t*>(&word), FUTEX_WAKE, INT_MAX, nullptr, nullptr, 0);
+  }
+
+  static std::string object_name(std::string_view name) {
+    return name.starts_with('/') ? std::string(name) : "/" + std::string(name);
+  }
+
+  Options options_;
+  int fd_ = -1;
+  Header* header_ = nullptr;
+  Slot* slots_ = nullptr;
+  std::size_t mapped_bytes_ = 0;
+  std::uint64_t mask_ = 0;
+  std::size_t reader_index_ = 0;
+  std::atomic<std::uint64_t> gate_{0};  // No active reader is behind this position.
+  std::atomic<bool> stopping_{false};
+  std::thread receiver_;
+
+  Reader& reader() { return header_->readers[reader_index_]; }
+
+  Slot& slot_at(std::uint64_t position) { return slots_[position & mask_]; }
+
+  //
+  // Maps the object, creating and initializing it if this is the first
+  // emitter on the name. Others wait until the creator has published the
+  // header.
+  //
+  void attach(const std::string& name) {
+    bool created = true;
+    fd_ = shm_open(name.c_str(), O_RDWR | O_CREAT | O_EXCL, 0600);
+    if (fd_ < 0 && errno == EEXIST) {
+      created = false;
+      fd_ = shm_open(name.c_str(), O_RDWR, 0600);
+    }
+    if (fd_ < 0) {
+      throw std::system_error(errno, std::generic_category(), "shm_open " + name);
+    }
+
+    std::size_t capacity = std::bit_ceil(std::max<std::size_t>(options_.capacity, 2));
+    if (created) {
+      if (ftruncate(fd_, off_t(SLOTS_OFFSET + capacity * SLOT_BYTES)) != 0) {
+        throw std::system_error(errno, std::generic_category(), "ftruncate " + name);
+      }
+    } else {
+      struct stat status;
+      while (fstat(fd_, &status) == 0 && std::size_t(status.st_size) < SLOTS_OFFSET) {
+        std::this_thread::yield();
+      }
+      auto header = static_cast<Header*>(mmap(nullptr, sizeof(Header), PROT_READ, MAP_SHARED, fd_, 0));
+      if (header == MAP_FAILED) {
+        throw std::system_error(errno, std::generic_category(), "mmap " + name);
+      }
+      std::uint64_t magic;
+      while ((magic = header->magic.load(std::memory_order_acquire)) == 0) {
+        std::this_thread::yield();
+      }
+      capacity = header->capacity;
+      munmap(header, sizeof(Header));
+      if (magic != MAGIC) {
+        throw std::runtime_error("SharedMemoryEmitter: " + name + " has an incompatible layout");
+      }
+    }
+
+    mapped_bytes_ = SLOTS_OFFSET + capacity * SLOT_BYTES;
+    void* memory = mmap(nullptr, mapped_bytes_, PROT_READ | PROT_WRITE, MAP_SHARED, fd_, 0);
+    if (memory == MAP_FAILED) {
+      throw std::system_error(errno, std::generic_category(), "mmap " + name);
+    }
+    header_ = static_cast<Header*>(memory);
+    slots_ = reinterpret_cast<Slot*>(static_cast<char*>(memory) + SLOTS_OFFSET);
+    mask_ = capacity - 1;
+
+    if (created) {
+      // The object starts zeroed, which is every atomic's initial state and
+      // a sequence no position is waiting for.
+      header_->capacity = capacity;
+      header_->magic.store(MAGIC, std::memory_order_release);
+    }
+  }
+
+  //
+  // Takes a free reader and starts it at the current tail. The cursor is
+  // set after the reader is marked active, so a producer that missed the
+  // activation can only be writing the first position this reader reads.
+  //
+  void join() {
+    reap_dead_readers();
+    for (std::size_t i = 0; i < MAX_READERS; ++i) {
+      std::int32_t expected = 0;
+      if (header_->readers[i].owner.compare_exchange_strong(expected, std::int32_t(getpid()))) {
+        reader_index_ = i;
+        reader().cursor.store(header_->tail.load());
+        return;
+      }
+    }
+    throw std::runtime_error("SharedMemoryEmitter: more than MAX_READERS emitters attached");
+  }
+
+  void detach() {
+    if (header_ != nullptr) {
+      munmap(header_, mapped_bytes_);
+      header_ = nullptr;
+    }
+    if (fd_ >= 0) {
+      close(fd_);
+      fd_ = -1;
+    }
+  }
+
+  //
+  // Whether `pid` still runs. A process that has exited but not been waited
+  // for still counts, and a reused pid can keep a dead owner alive.
+  //
+  static bool alive(std::int32_t pid) {
+    return kill(pid_t(pid), 0) == 0 || errno == EPERM;
+  }
+
+  //
+  // Frees the readers of processes that died without detaching. Only the
+  // dead pid is swapped out, so a reader taken again meanwhile is kept.
+  //
+  void reap_dead_readers() {
+    for (Reader& r : header_->readers) {
+      std::int32_t owner = r.owner.load();
+      if (owner != 0 && !alive(owner)) {
+        r.owner.compare_exchange_strong(owner, 0);
+      }
+    }
+  }
+
+  // The lowest cursor of any active reader, or `position` if none is behind it.
+  std::uint64_t slowest_reader(std::uint64_t position) const {
+    std::uint64_t slowest = position;
+    for (const Reader& r : header_->readers) {
+      if (r.owner.load() != 0) {
+        slowest = std::min(slowest, r.cursor.load());
+      }
+    }
+    return slowest;
+  }
+
+  //
+  // Claims the next position, waiting (or failing) while the slowest reader
+  // is a whole ring behind it. `gate_` caches the last slowest cursor seen;
+  // cursors only move forward and new readers start at the tail, so it
+  // stays a safe lower bound. A full ring first frees the readers of dead
+  // processes, which would otherwise hold it full forever.
+  //
+  bool claim(std::uint64_t& position) {
+    position = header_->tail.load();
+    for (;;) {
+      if (position - gate_.load(std::memory_order_relaxed) > mask_) {
+        std::uint64_t gate = slowest_reader(position);
+        if (position - gate > mask_) {
+          reap_dead_readers();
+          gate = slowest_reader(position);
+        }
+        gate_.store(gate, std::memory_order_relaxed);
+        if (position - gate > mask_) {
+          if (!options_.block_when_full) {
+            return false;
+          }
+          std::this_thread::yield();
+          position = header_->tail.load();
+          continue;
+        }
+      }
+      if (header_->tail.compare_exchange_weak(position, position + 1)) {
+        slot_at(position).claim.store(claim_word(position, getpid()), std::memory_order_relaxed);
+        return true;
+      }
+    }
+  }
+
+  static std::uint64_t claim_word(std::uint64_t position, pid_t pid) {
+    return ((position + 1) << 32) | std::uint32_t(pid);
+  }
+
+  //
+  // Whether the producer that claimed `position` died before publishing
+  // it. A producer that dies between taking the position and storing its
+  // claim is not detected.
+  //
+  bool abandoned(Slot& slot, std::uint64_t position) {
+    if (position >= header_->tail.load()) {
+      return false;  // Not claimed yet.
+    }
+    std::uint64_t claim = slot.claim.load(std::memory_order_relaxed);
+    if ((claim >> 32) != ((position + 1) & 0xffffffffu)) {
+      return false;
+    }
+    return slot.sequence.load(std::memory_order_acquire) != position + 1 && !alive(std::int32_t(claim & 0xffffffffu));
+  }
+
+  void publish(Slot& slot, std::uint64_t position) {
+    // Sequentially consistent, pairing with the sleepers increment in
+    // receive(): either the reader sees this slot or this sees the sleeper.
+    slot.sequence.store(position + 1);
+    if (header_->sleepers.load() != 0) {
+      header_->signal.fetch_add(1);
+      futex_wake_all(header_->signal);
+    }
+  }
+
+  void receive() {
+    static constexpr int SPINS_BEFORE_SLEEP = 64;
+    std::uint64_t position = reader().cursor.load();
+    int idle = 0;
+
+    while (!stopping_.load(std::memory_order_relaxed)) {
+      Slot& slot = slot_at(position);
+      if (slot.sequence.load(std::memory_order_acquire) == position + 1) {
+        Record record{std::string_view(slot.name, slot.name_length), slot.fingerprint, slot.payload};
+        EventEmitter::emit(record.name, record);
+        reader().cursor.store(++position, std::memory_order_release);
+        idle = 0;
+        continue;
+      }
+      if (++idle < SPINS_BEFORE_SLEEP) {
+        std::this_thread::yield();
+        continue;
+      }
+      if (abandoned(slot, position)) {
+        reader().cursor.store(++position, std::memory_order_release);  // Nothing will ever be published there.
+        idle = 0;
+        continue;
+      }
+      header_->sleepers.fetch_add(1);
+      std::uint32_t seen = header_->signal.load();
+      if (slot.sequence.load() != position + 1 && !stopping_.load()) {
+        // Wakes up now and then while a claimed slot is unpublished, to see
+        // whether its producer died.
+        futex_wait(header_->signal, seen, position < header_->tail.load() ? &ABANDON_CHECK : nullptr);
+      }
+      header_->sleepers.fetch_sub(1);
+    }
+  }
+
+public:
+  using EventEmitter::Subscription;
+  using EventEmitter::ScopedSubscription;
+  using EventEmitter::Propagation;
+  using EventEmitter::maxListeners;
+  using EventEmitter::listeners;
+  using EventEmitter::setLeakWarningHandler;
+  using EventEmitter::off;
+
+  explicit SharedMemoryEmitter(std::string_view name) : SharedMemoryEmitter(name, Options{}) {}
+
+  SharedMemoryEmitter(std::string_view name, const Options& options) : options_(options) {
+    try {
+      attach(object_name(name));
+      join();
+    } catch (...) {
+      detach();
+      throw;
+    }
+    receiver_ = std::thread([this] { receive(); });
+  }
+
+  SharedMemoryEmitter(const SharedMemoryEmitter&) = delete;
+  SharedMemoryEmitter& operator=(const SharedMemoryEmitter&) = delete;
+
+  //
+  // Stops receiving and leaves the bus. Emits this emitter has not received
+  // yet are not delivered here.
+  //
+  ~SharedMemoryEmitter() {
+    stopping_.store(true);
+    header_->signal.fetch_add(1);
+    futex_wake_all(header_->signal);
+    receiver_.join();
+    reader().owner.store(0);
+    detach();
+  }
+
+  //
+  // Removes the name, as shm_unlink does. Attached emitters keep working;
+  // the next emitter on the name creates a new bus.
+  //
+  static bool unlink(std::string_view name) {
+    return shm_unlink(object_name(name).c_str()) == 0;
+  }
+
+  template <typename Callback>
+  Subscription on(std::string_view name, Callback&& cb, int priority = 0) {
+    return EventEmitter::on(name, make_receiver(std::forward<Callback>(cb), static_cast<arguments_t<Callback>*>(nullptr)), priority);
+  }
+
+  template <typename Callback>
+  Subscription once(std::string_view name, Callback&& cb, int priority = 0) {
+    return EventEmitter::once(name, make_receiver(std::forward<Callback>(cb), static_cast<arguments_t<Callback>*>(nullptr)), priority);
+  }
+
+  //
+  // Publishes the emit to every attached emitter and returns without
+  // waiting for listeners. The argument types must be exactly those the
+  // listeners take. Returns false if the ring is full and
+  // `block_when_full` is off, or if the name is longer than MAX_NAME, which
+  // is also reported to std::cerr. Names given as string literals are
+  // checked at compile time instead.
+  //
+  template <typename... EmitArgs>
+  bool emit(std::string_view name, EmitArgs&&... args) {
+    static_assert((is_transportable<std::decay_t<EmitArgs>> && ...),
+                  "SharedMemoryEmitter arguments must be trivially copyable and not pointers");
+    using Payload = Layout<std::decay_t<EmitArgs>...>;
+    static_assert(Payload::size <= MAX_PAYLOAD, "SharedMemoryEmitter arguments do not fit in a slot");
+
+    if (name.size() > MAX_NAME) {
+      std::cerr << "Emit error for event '" << name << "': "
+                << "Name longer than " << MAX_NAME << " bytes."
+                << std::endl;
+      return false;
+    }
+
+    std::uint64_t position;
+    if (!claim(position)) {
+      return false;
+    }
+    Slot& slot = slot_at(position);
+    slot.fingerprint = fingerprint<std::decay_t<EmitArgs>...>;
+    slot.name_length = std::uint16_t(name.size());
+    slot.payload_size = std::uint16_t(Payload::size);
+    std::memcpy(slot.name, name.data(), name.size());
+    [[maybe_unused]] std::size_t i = 0;
+    (std::memcpy(slot.payload + Payload::offsets[i++], &args, sizeof(std::decay_t<EmitArgs>)), ...);
+    publish(slot, position);
+    return true;
+  }
+
+  template <std::size_t N, typename... EmitArgs>
+    requires (N - 1 > MAX_NAME)
+  bool emit(const char (&name)[N], EmitArgs&&... args) = delete;  // Longer than MAX_NAME.
+
+  //
+  // Waits until this emitter has called its listeners for every emit
+  // published on the bus before the call. Must not be called from a
+  // listener.
+  //
+  void drain() {
+    std::uint64_t target = header_->tail.load();
+    while (reader().cursor.load(std::memory_order_acquire) < target) {
+      std::this_thread::yield();
+    }
+  }
+};
+
+#endif // __linux__
+
+#endif // __EVENTS_SHM_H_
@@ -6,8 +6,33 @@
 #include <cstdlib>
 #include <sstream>
 #include <utility>
+#include <mutex>
+#include <span>
+#include <new>
+#include <algorithm>
+#include <array>
+#include <memory>
+#include <memory_resource>
+#include <cstdint>
+#include <coroutine>
+#include <exception>
+#include <functional>
 
+#include <signal.h>
+#include <sys/mman.h>
+#include <sys/wait.h>
+#include <unistd.h>
+
+// The suite runs with instrumentation compiled in so stats() can be checked.
+// `make test` also runs it with -DEVENTEMITTER_STATS=0, the default.
+#ifndef EVENTEMITTER_STATS
+#define EVENTEMITTER_STATS 1
+#endif
 #include "../index.hxx"
+#if defined(__linux__)
+#include "../shm.hxx"
+#endif
+#include "../record.hxx"
 
 int assertions_run = 0;
 int assertions_passed = 0;
@@ -23,6 +48,11 @@ int assertions_passed = 0;
   } \
 } while(0)
 
+// The library declares nothing named Event at global scope, so programs can.
+struct Event {
+  int id = 0;
+};
+
 struct CallbackTracker {
   int called_count = 0;
   void trigger() { called_count++; }
@@ -40,6 +70,15 @@ struct ComplexArg {
   }
 };
 
+struct CopyCounter {
+  static int copies;
+  std::string payload;
+  CopyCounter(std::string p = "") : payload(std::move(p)) {}
+  CopyCounter(const CopyCounter& other) : payload(other.payload) { copies++; }
+  CopyCounter(CopyCounter&& other) noexcept = default;
+};
+int CopyCounter::copies = 0;
+
 struct TestFunctor {
   CallbackTracker& tracker;
   explicit TestFunctor(CallbackTracker& t) : tracker(t) {}
@@ -71,6 +110,23 @@ public:
   StreamRedirector& operator=(const StreamRedirector&) = delete;
 };
 
+// Tracks the bytes an emitter holds, for tests that check memory stays flat.
+struct CountingResource : std::pmr::memory_resource {
+  std::atomic<std::size_t> outstanding{0};
+
+  void* do_allocate(std::size_t bytes, std::size_t alignment) override {
+    outstanding += bytes;
+    return std::pmr::new_delete_resource()->allocate(bytes, alignment);
+  }
+  void do_deallocate(void* p, std::size_t bytes, std::size_t alignment) override {
+    outstanding -= bytes;
+    std::pmr::new_delete_resource()->deallocate(p, bytes, alignment);
+  }
+  bool do_is_equal(const std::pmr::memory_resource& other) const noexcept override {
+    return this == &other;
+  }
+};
+
 
 // Test #21 Worker Function, These atonics will be shared by threads in the test
 std::atomic<int> async_total_on_callbacks_fired(0);
@@ -105,7 +161,230 @@ void async_worker_function(EventEmitter& emitter, int thread_id) {
 }
 
 
-int main() {
+// Counts global allocations, so Test #33 can check that emit makes none.
+std::atomic<long> heap_allocations{0};
+
+void* operator new(std::size_t size) {
+  heap_allocations++;
+  if (void* p = std::malloc(size ? size : 1)) return p;
+  throw std::bad_alloc();
+}
+
+// std::stable_sort's temporary buffer comes from here and goes back through
+// the replaced delete below.
+void* operator new(std::size_t size, const std::nothrow_t&) noexcept {
+  heap_allocations++;
+  return std::malloc(size ? size : 1);
+}
+
+// GCC pairs inlined coroutine frame deletes with the replaced operator new
+// above and warns about the free().
+#if defined(__GNUC__) && !defined(__clang__)
+#pragma GCC diagnostic push
+#pragma GCC diagnostic ignored "-Wmismatched-new-delete"
+#endif
+void operator delete(void* p) noexcept { std::free(p); }
+void operator delete(void* p, std::size_t) noexcept { std::free(p); }
+#if defined(__GNUC__) && !defined(__clang__)
+#pragma GCC diagnostic pop
+#endif
+
+// Over-aligned requests are carved out of a counted plain allocation, which
+// is remembered just below the aligned pointer.
+void* operator new(std::size_t size, std::align_val_t alignment) {
+  std::size_t align = std::max(static_cast<std::size_t>(alignment), alignof(std::max_align_t));
+  auto raw = static_cast<char*>(::operator new(size + align));
+  char* aligned = raw + align - reinterpret_cast<std::uintptr_t>(raw) % align;
+  reinterpret_cast<void**>(aligned)[-1] = raw;
+  return aligned;
+}
+
+void operator delete(void* p, std::align_val_t) noexcept {
+  if (p != nullptr) ::operator delete(static_cast<void**>(p)[-1]);
+}
+void operator delete(void* p, std::size_t, std::align_val_t alignment) noexcept { ::operator delete(p, alignment); }
+
+// Fire-and-forget coroutine for Test #36.
+struct Detached {
+  struct promise_type {
+    Detached get_return_object() { return {}; }
+    std::suspend_never initial_suspend() noexcept { return {}; }
+    std::suspend_never final_suspend() noexcept { return {}; }
+    void return_void() {}
+    void unhandled_exception() { std::terminate(); }
+  };
+};
+
+#if defined(__SANITIZE_THREAD__)
+#define TEST_THREAD_SANITIZER 1
+#elif defined(__has_feature)
+#if __has_feature(thread_sanitizer)
+#define TEST_THREAD_SANITIZER 1
+#endif
+#endif
+
+#if defined(__linux__)
+const int SHM_PRODUCERS = 3;
+const int SHM_CONSUMERS = 2;
+const int SHM_EMITS = 20000;
+
+// The processes of Test #37, by role. Returns the exit status.
+int shm_child(const std::string& role, const std::string& name, int index) {
+  if (role == "consumer") {
+    SharedMemoryEmitter bus(name);
+    std::array<int, SHM_PRODUCERS> next_seq{};
+    std::atomic<bool> ordered{true}; std::atomic<bool> done{false}; std::atomic<long> count{0};
+    bus.on("tick", [&](int producer, int seq) {
+      if (seq != next_seq[producer]++) ordered = false;
+      count++;
+    });
+    bus.on("done", [&]() { done = true; });
+    bus.emit("ready", index);
+    while (!done.load()) std::this_thread::yield();
+    return ordered && count == long(SHM_PRODUCERS) * SHM_EMITS ? 0 : 1;
+  }
+  if (role == "producer") {
+    SharedMemoryEmitter bus(name);
+    bool ok = true;
+    for (int i = 0; i < SHM_EMITS; ++i) {
+      ok = bus.emit("tick", index, i) && ok;
+    }
+    return ok ? 0 : 1;
+  }
+  if (role == "dead-reader") {
+    new SharedMemoryEmitter(name);  // Never destroyed.
+    _exit(0);  // Before the leak checker can run.
+  }
+  if (role == "dead-producer") {
+    signal(SIGSEGV, SIG_DFL);
+    SharedMemoryEmitter bus(name);
+    void* unreadable = mmap(nullptr, 4096, PROT_NONE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+    bus.emit("tick", *static_cast<int*>(unreadable));  // Faults while copying, after the claim.
+    return 0;
+  }
+  return 2;
+}
+
+// Runs a role of shm_child in a child process and collects its exit status.
+// The child execs this binary again rather than running on after fork: a
+// lock another thread held at the fork (in the allocator, say) would stay
+// held in the child forever. Under ThreadSanitizer the role runs on a
+// thread of this process instead, so the sanitizer sees both sides of the
+// ring.
+class ChildProcess {
+  pid_t pid_ = -1;
+  std::thread thread_;
+  std::atomic<int> status_{-1};
+
+public:
+  ChildProcess(const char* role, const std::string& name, int index) {
+#ifdef TEST_THREAD_SANITIZER
+    thread_ = std::thread([this, role, name, index] { status_ = shm_child(role, name, index); });
+#else
+    std::string index_arg = std::to_string(index);
+    pid_ = fork();
+    if (pid_ == 0) {
+      execl("/proc/self/exe", "test_runner", "--shm-child", role, name.c_str(), index_arg.c_str(), nullptr);
+      _exit(127);
+    }
+#endif
+  }
+
+  bool running() const {
+#ifdef TEST_THREAD_SANITIZER
+    return true;
+#else
+    return waitpid(pid_, nullptr, WNOHANG) == 0;
+#endif
+  }
+
+#ifndef TEST_THREAD_SANITIZER
+  // Waits for the child and returns its status, as waitpid reports it.
+  int wait() {
+    int status = 0;
+    return waitpid(pid_, &status, 0) == pid_ ? status : -1;
+  }
+#endif
+
+  // True if the role returned 0.
+  bool succeeded() {
+#ifdef TEST_THREAD_SANITIZER
+    thread_.join();
+    return status_ == 0;
+#else
+    int status = wait();
+    return status != -1 && WIFEXITED(status) && WEXITSTATUS(status) == 0;
+#endif
+  }
+};
+#endif
+
+Detached wait_for_ready(EventEmitter& emitter, std::atomic<long>& sum) {
+  int value = co_await emitter.next<int>("ready");
+  sum += value;
+}
+
+Detached wait_for_pair(EventEmitter& emitter, int& id, std::string& text) {
+  auto [next_id, next_text] = co_await emitter.next<int, std::string>("pair");
+  id = next_id;
+  text = next_text;
+}
+
+Detached wait_repeatedly(EventEmitter& emitter, int rounds, std::atomic<int>& resumed) {
+  for (int i = 0; i < rounds; ++i) {
+    co_await emitter.next<>("go");
+    resumed++;
+  }
+}
+
+Detached await_emit(EventEmitter& emitter, int job, std::atomic<int>& finished, std::atomic<int>& succeeded) {
+  bool ok = co_await emitter.emitAwait("job", job);
+  succeeded += ok;
+  finished++;
+}
+
+// Argument types for Test #38: one recorded byte for byte, one through its
+// EventSerializer.
+struct Point {
+  int x;
+  double y;
+};
+
+struct Tagged {
+  std::string label;
+  std::vector<int> values;
+};
+
+template <>
+struct EventSerializer<Tagged> {
+  static std::size_t size(const Tagged& t) {
+    return sizeof(std::uint32_t) + t.label.size() + t.values.size() * sizeof(int);
+  }
+  static void write(const Tagged& t, std::byte* out) {
+    auto length = std::uint32_t(t.label.size());
+    std::memcpy(out, &length, sizeof(length));
+    std::memcpy(out + sizeof(length), t.label.data(), length);
+    std::memcpy(out + sizeof(length) + length, t.values.data(), t.values.size() * sizeof(int));
+  }
+  static Tagged read(const std::byte* in, std::size_t size) {
+    std::uint32_t length;
+    std::memcpy(&length, in, sizeof(length));
+    Tagged t{std::string(reinterpret_cast<const char*>(in + sizeof(length)), length), {}};
+    t.values.resize((size - sizeof(length) - length) / sizeof(int));
+    std::memcpy(t.values.data(), in + sizeof(length) + length, t.values.size() * sizeof(int));
+    return t;
+  }
+};
+
+int main(int argc, char** argv) {
+#if defined(__linux__)
+  if (argc == 5 && std::string(argv[1]) == "--shm-child") {
+    return shm_child(argv[2], argv[3], std::atoi(argv[4]));
+  }
+#else
+  (void)argc; (void)argv;
+#endif
+
   /// - Test #1: Sanity and maxListeners default
   ASSERT("Sanity: true is true", true == true);
   EventEmitter ee_default;
@@ -171,6 +450,24 @@ int main() {
   ASSERT("off(event1): listener count is 1 (event2 remains)", ee.listeners() == 1);
   ee.off("non_existent_to_off");
   ASSERT("off(non_existent_event): listener count still 1", ee.listeners() == 1);
+  int req_calls = 0;
+  for (int i = 0; i < 20000; ++i) {
+    std::string name = "request." + std::to_string(i);
+    ee.on(name, [&]() { req_calls++; });
+    ee.emit(name);
+    ee.off(name);
+  }
+  for (int i = 0; i < 20000; ++i) {
+    std::string name = "reply." + std::to_string(i);
+    ee.once(name, [&]() { req_calls++; });
+    ee.emit(name);
+  }
+  ASSERT("release: every per-request listener ran once", req_calls == 40000 && ee.listeners() == 1);
+  ee.on("request.7", [&]() { req_calls++; });
+  ee.emit("request.7");
+  ee.emit("request.8");
+  ASSERT("release: a released name can be listened to again", req_calls == 40001);
+  ee.off("request.7");
 
   /// - Test #7: 'once(eventName, callback)'
   EventEmitter ee_once;
@@ -378,8 +675,1205 @@ int main() {
   ASSERT("Async Test: Total 'once' callbacks fired correctly", async_total_once_callbacks_fired.load() == expected_once_callbacks);
   ASSERT("Async Test: Total listeners registered (sanity check)", async_total_listeners_registered.load() == expected_total_registrations);
   ASSERT("Async Test: Final listener count in emitter correct", ee_async_test.listeners() == expected_final_listeners);
+
+  {
+    EventEmitter req_ee; req_ee.maxListeners = 100;
+    const int req_threads = 4, req_per_thread = 2000;
+    std::atomic<bool> req_stop{false};
+    std::atomic<int> req_wrong{0};
+    std::thread req_emitter([&]() {
+      // Emits names that are being released and created again under it.
+      for (int i = 0; !req_stop.load(); i = (i + 1) % req_per_thread) {
+        req_ee.emit("request." + std::to_string(i % req_threads) + "." + std::to_string(i), 0);
+      }
+    });
+    std::vector<std::thread> req_workers;
+    for (int t = 0; t < req_threads; ++t) {
+      req_workers.emplace_back([&, t]() {
+        std::atomic<int> calls{0};  // The emitter thread may call it too, with 0.
+        for (int i = 0; i < req_per_thread; ++i) {
+          std::string name = "request." + std::to_string(t) + "." + std::to_string(i);
+          req_ee.on(name, [&calls](int v) { calls += v; });
+          req_ee.emit(name, 1);
+          req_ee.off(name);
+        }
+        if (calls != req_per_thread) {
+          req_wrong++;
+        }
+      });
+    }
+    for (auto& worker : req_workers) {
+      worker.join();
+    }
+    req_stop = true;
+    req_emitter.join();
+    ASSERT("release: names released and created concurrently reach only their own listeners", req_wrong == 0);
+    ASSERT("release: no listener is left after concurrent releases", req_ee.listeners() == 0);
+  }
   std::cout << "...Finished Test #23: Async Operations.\n";
 
+  /// - Test #22: Interned event ids and compile-time hashed names
+  using namespace eventemitter::literals;
+  EventEmitter ee_ids; CallbackTracker tracker_ids; int ids_arg_sum = 0;
+  EventEmitter::EventId tick_id = ee_ids.id("tick");
+  ASSERT("Event ids: same name interns to the same id", ee_ids.id(std::string("tick")) == tick_id);
+  ASSERT("Event ids: different names intern to different ids", ee_ids.id("tock") != tick_id);
+  ASSERT("Event ids: interning alone adds no listeners", ee_ids.listeners() == 0);
+  ee_ids.on(tick_id, [&](int v) { tracker_ids.trigger(); ids_arg_sum += v; });
+  ee_ids.on("tick", [&](int v) { tracker_ids.trigger(); ids_arg_sum += v; });
+  ee_ids.emit(tick_id, 1);
+  ee_ids.emit("tick", 2);
+  ee_ids.emit("tick"_event, 3);
+  ee_ids.emit(std::string_view("tick"), 4);
+  ASSERT("Event ids: id, string, literal and string_view emits reach every listener", tracker_ids.count() == 8);
+  ASSERT("Event ids: arguments delivered through every overload", ids_arg_sum == 2 * (1 + 2 + 3 + 4));
+  ee_ids.once("tick"_event, [&](int) { tracker_ids.trigger(); });
+  ee_ids.emit(tick_id, 0);
+  ee_ids.emit(tick_id, 0);
+  ASSERT("Event ids: once via literal fires a single time", tracker_ids.count() == 8 + 3 + 2);
+  ee_ids.off(tick_id);
+  ASSERT("Event ids: off(id) removes the listeners", ee_ids.listeners() == 0);
+  ee_ids.emit("tick", 5);
+  ASSERT("Event ids: no calls after off(id)", tracker_ids.count() == 13);
+  ASSERT("Event ids: id survives off()", ee_ids.id("tick") == tick_id);
+  ee_ids.on(EventEmitter::EventId(), [&]() { tracker_ids.trigger(); });
+  ee_ids.emit(EventEmitter::EventId());
+  ASSERT("Event ids: default-constructed id is ignored", ee_ids.listeners() == 0 && tracker_ids.count() == 13);
+  EventEmitter::EventId pinned_id = ee_ids.id("pinned");
+  ee_ids.on("pinned", [&]() { tracker_ids.trigger(); });
+  ee_ids.off("pinned");
+  ee_ids.on(pinned_id, [&]() { tracker_ids.trigger(); });
+  ee_ids.emit("pinned");
+  ASSERT("Event ids: an event with an id is never released", tracker_ids.count() == 14 && ee_ids.id("pinned") == pinned_id);
+
+  /// - Test #23: Many interned names (index growth)
+  EventEmitter ee_many; ee_many.maxListeners = 2000; int many_sum = 0;
+  for (int i = 0; i < 1000; ++i) {
+    ee_many.on("many_" + std::to_string(i), [&, i]() { many_sum += i; });
+  }
+  for (int i = 0; i < 1000; ++i) {
+    ee_many.emit("many_" + std::to_string(i));
+  }
+  ASSERT("Index growth: every event still reachable after the index grew", many_sum == 999 * 1000 / 2);
+  ASSERT("Index growth: listener count is 1000", ee_many.listeners() == 1000);
+
+  /// - Test #24: Inline and heap-stored callables survive list copies
+  EventEmitter ee_storage; int small_sum = 0; int large_sum = 0; int mutable_calls = 0;
+  struct { int values[32]; } large_capture = {};
+  large_capture.values[31] = 7;
+  ee_storage.on("storage_event", [&small_sum](int v) { small_sum += v; });
+  ee_storage.on("storage_event", [&large_sum, large_capture](int v) { large_sum += v * large_capture.values[31]; });
+  ee_storage.on("storage_event", [&mutable_calls, count = 0](int) mutable { mutable_calls = ++count; });
+  ee_storage.on("storage_event", [](int) {}); // Forces another copy of the list
+  ee_storage.emit("storage_event", 2);
+  ee_storage.emit("storage_event", 3);
+  ASSERT("Callable storage: inline capture called with correct args", small_sum == 5);
+  ASSERT("Callable storage: heap capture keeps its state across copies", large_sum == 35);
+  ASSERT("Callable storage: mutable lambda keeps its own state", mutable_calls == 2);
+  std::stringstream captured_cerr_mixed;
+  ee_storage.on("storage_event", [&](const std::string&) { small_sum = -1; });
+  {
+    StreamRedirector redirect(std::cerr, captured_cerr_mixed.rdbuf());
+    ee_storage.emit("storage_event", 1);
+  }
+  ASSERT("Callable storage: mixed signatures still call matching listeners", large_sum == 42 && small_sum == 6);
+  ASSERT("Callable storage: mismatching listener reported", captured_cerr_mixed.str().find("Callback signature mismatch") != std::string::npos);
+  EventEmitter ee_empty_fn; bool empty_fn_threw = false; int after_empty_fn = 0;
+  ee_empty_fn.on("empty", std::function<void(int)>());
+  ee_empty_fn.on("empty", [&](int value) { after_empty_fn = value; });
+  std::stringstream captured_cerr_empty;
+  std::streambuf* old_cerr_empty = std::cerr.rdbuf(captured_cerr_empty.rdbuf());
+  try {
+    ee_empty_fn.emit("empty", 1);
+  } catch (const std::bad_function_call&) {
+    empty_fn_threw = true;
+  }
+  std::cerr.rdbuf(old_cerr_empty);
+  ASSERT("Callable storage: an empty std::function listener is reported, not thrown",
+    !empty_fn_threw && after_empty_fn == 1 && captured_cerr_empty.str().find("Bad function call") != std::string::npos);
+
+  /// - Test #25: TypedEmitter with compile-time event schema
+  using Schema = TypedEmitter<
+    eventemitter::Event<"tick", void(int)>,
+    eventemitter::Event<"message", void(const std::string&, int)>,
+    eventemitter::Event<"counter", void(int&)>,
+    eventemitter::Event<"close", void()>
+  >;
+  Schema typed;
+  int typed_tick_sum = 0; std::string typed_message; int typed_closes = 0;
+  typed.on<"tick">([&](int v) { typed_tick_sum += v; });
+  typed.on<"tick">([&](const auto& v) { typed_tick_sum += v * 10; });
+  typed.on<"message">([&](const std::string& text, int repeat) {
+    for (int i = 0; i < repeat; ++i) typed_message += text;
+  });
+  typed.on<"counter">([](int& counter) { counter++; });
+  typed.once<"close">([&]() { typed_closes++; });
+  ASSERT("TypedEmitter: listener count", typed.listeners() == 5);
+  typed.emit<"tick">(4);
+  typed.emit<"message">(std::string("ab"), 2);
+  typed.emit<"message">("c", 1);
+  int typed_counter = 0;
+  typed.emit<"counter">(typed_counter);
+  typed.emit<"counter">(typed_counter);
+  typed.emit<"close">();
+  typed.emit<"close">();
+  ASSERT("TypedEmitter: every listener receives the arguments", typed_tick_sum == 44);
+  ASSERT("TypedEmitter: arguments converted to declared types", typed_message == "ababc");
+  ASSERT("TypedEmitter: reference parameters reach the caller's object", typed_counter == 2);
+  ASSERT("TypedEmitter: once listener fires once", typed_closes == 1);
+  ASSERT("TypedEmitter: once listener removed", typed.listeners() == 4);
+  typed.off<"tick">();
+  typed.emit<"tick">(1);
+  ASSERT("TypedEmitter: off<name> removes listeners", typed_tick_sum == 44 && typed.listeners() == 2);
+  typed.off();
+  ASSERT("TypedEmitter: off() removes everything", typed.listeners() == 0);
+  TypedEmitter<eventemitter::Event<"value", void(CopyCounter, std::string)>> typed_values;
+  std::string typed_value_seen;
+  typed_values.on<"value">([&](const CopyCounter& c, const std::string& s) { typed_value_seen = c.payload + s; });
+  CopyCounter typed_value("kept");
+  CopyCounter::copies = 0;
+  typed_values.emit<"value">(typed_value, "!");
+  typed_values.emit<"value">(CopyCounter("moved"), std::string("?"));
+  ASSERT("TypedEmitter: by-value parameters of the declared type are not copied",
+    CopyCounter::copies == 0 && typed_value_seen == "moved?");
+
+  /// - Test #26: Arguments are forwarded by reference, not copied per listener
+  EventEmitter ee_forward; ee_forward.maxListeners = 20;
+  CopyCounter forwarded("payload");
+  const CopyCounter* seen_address = nullptr; int const_ref_calls = 0;
+  for (int i = 0; i < 10; ++i) {
+    ee_forward.on("forward_event", [&](const CopyCounter& c) {
+      const_ref_calls++;
+      seen_address = &c;
+    });
+  }
+  CopyCounter::copies = 0;
+  ee_forward.emit("forward_event", forwarded);
+  ASSERT("Forwarding: every const& listener called", const_ref_calls == 10);
+  ASSERT("Forwarding: const& listeners see the caller's object", seen_address == &forwarded);
+  ASSERT("Forwarding: no copies for const& listeners", CopyCounter::copies == 0);
+  ee_forward.emit("forward_event", CopyCounter("temporary"));
+  ASSERT("Forwarding: no copies when emitting an rvalue", CopyCounter::copies == 0);
+
+  std::string by_value_seen; std::string rvalue_seen;
+  ee_forward.on("forward_value", [&](CopyCounter c) { by_value_seen = c.payload; });
+  ee_forward.on("forward_value", [&](CopyCounter&& c) { rvalue_seen = std::move(c.payload); });
+  ee_forward.on("forward_value", [&](const CopyCounter& c) { by_value_seen += c.payload; });
+  CopyCounter::copies = 0;
+  ee_forward.emit("forward_value", forwarded);
+  ASSERT("Forwarding: by-value and && listeners each get one copy", CopyCounter::copies == 2);
+  ASSERT("Forwarding: && listener moving its copy leaves the caller's object intact", rvalue_seen == "payload" && forwarded.payload == "payload");
+  ASSERT("Forwarding: later listeners unaffected by an earlier move", by_value_seen == "payloadpayload");
+  std::string literal_seen;
+  ee_forward.on("forward_literal", [&](const char* text) { literal_seen = text; });
+  ee_forward.emit("forward_literal", "literal");
+  ASSERT("Forwarding: string literal reaches a const char* listener", literal_seen == "literal");
+
+  /// - Test #27: emitAsync dispatches on worker threads, in order per event
+  EventEmitter ee_async_emit; ee_async_emit.maxListeners = 20;
+  ee_async_emit.configureAsync({2 /*threads*/, 64 /*capacity*/, EventEmitter::Backpressure::Block});
+  const int ASYNC_EMIT_PRODUCERS = 4, ASYNC_EMIT_PER_PRODUCER = 500;
+  std::vector<int> async_last_seen(ASYNC_EMIT_PRODUCERS, -1);
+  std::atomic<int> async_out_of_order(0), async_delivered(0);
+  std::thread::id async_caller = std::this_thread::get_id();
+  std::atomic<bool> async_ran_on_caller(false);
+  for (int p = 0; p < ASYNC_EMIT_PRODUCERS; ++p) {
+    ee_async_emit.on("async_p" + std::to_string(p), [&, p](int seq) {
+      if (seq != async_last_seen[p] + 1) async_out_of_order++;
+      async_last_seen[p] = seq;
+      if (std::this_thread::get_id() == async_caller) async_ran_on_caller = true;
+      async_delivered++;
+    });
+  }
+  std::vector<std::thread> async_producers;
+  for (int p = 0; p < ASYNC_EMIT_PRODUCERS; ++p) {
+    async_producers.emplace_back([&, p]() {
+      std::string name = "async_p" + std::to_string(p);
+      for (int i = 0; i < ASYNC_EMIT_PER_PRODUCER; ++i) {
+        ee_async_emit.emitAsync(name, i);
+      }
+    });
+  }
+  for (auto& t : async_producers) t.join();
+  ee_async_emit.drain();
+  ASSERT("emitAsync: every event delivered after drain()", async_delivered.load() == ASYNC_EMIT_PRODUCERS * ASYNC_EMIT_PER_PRODUCER);
+  ASSERT("emitAsync: events with the same name stay in order", async_out_of_order.load() == 0);
+  ASSERT("emitAsync: listeners never run on the emitting thread", !async_ran_on_caller.load());
+  {
+    EventEmitter req_ee;
+    std::atomic<bool> req_started{false}, req_resume{false};
+    std::atomic<int> req_calls{0};
+    req_ee.once("request.queued", [&]() {
+      req_started = true;
+      while (!req_resume.load()) std::this_thread::yield();
+    });
+    for (int i = 0; i < 100; ++i) {
+      req_ee.emitAsync("request.queued");
+    }
+    while (!req_started.load()) std::this_thread::yield();
+    req_ee.off("request.queued");  // 99 emits are still queued behind the first.
+    for (int i = 0; i < 100; ++i) {
+      std::string name = "request." + std::to_string(i);
+      req_ee.on(name, [&]() { req_calls++; });  // Reuses every released slot it can.
+      req_ee.emit(name);
+      req_ee.off(name);
+    }
+    req_ee.on("request.queued", [&]() { req_calls++; });
+    req_resume = true;
+    req_ee.drain();
+    ASSERT("emitAsync: queued emits keep their event and reach its listeners at dispatch", req_calls == 100 + 99);
+  }
+
+  /// - Test #28: emitAsync backpressure policies
+  std::atomic<bool> slow_release(false), slow_started(false);
+  std::vector<int> slow_seen; std::mutex slow_seen_mtx;
+  auto slow_listener = [&](int v) {
+    slow_started = true;
+    while (!slow_release.load()) std::this_thread::yield();
+    std::lock_guard<std::mutex> lock(slow_seen_mtx);
+    slow_seen.push_back(v);
+  };
+
+  EventEmitter ee_fail;
+  ee_fail.configureAsync({1, 2, EventEmitter::Backpressure::Fail});
+  ee_fail.on("slow", slow_listener);
+  ee_fail.emitAsync("slow", 0);
+  while (!slow_started.load()) std::this_thread::yield();
+  int fail_accepted = 1; bool fail_rejected = false;
+  for (int i = 1; i < 10; ++i) {
+    if (ee_fail.emitAsync("slow", i)) fail_accepted++; else fail_rejected = true;
+  }
+  slow_release = true;
+  ee_fail.drain();
+  ASSERT("Backpressure::Fail: full queue rejects events", fail_rejected && fail_accepted == 3);
+  ASSERT("Backpressure::Fail: accepted events all delivered", (int)slow_seen.size() == fail_accepted);
+
+  EventEmitter ee_drop;
+  ee_drop.configureAsync({1, 2, EventEmitter::Backpressure::DropOldest});
+  ee_drop.on("slow", slow_listener);
+  slow_release = false; slow_started = false; slow_seen.clear();
+  ee_drop.emitAsync("slow", 0);
+  while (!slow_started.load()) std::this_thread::yield();
+  for (int i = 1; i <= 10; ++i) {
+    ee_drop.emitAsync("slow", i);
+  }
+  slow_release = true;
+  ee_drop.drain();
+  ASSERT("Backpressure::DropOldest: newest events kept", slow_seen == std::vector<int>({0, 9, 10}));
+
+  /// - Test #29: emitBatch delivers per item or as a span
+  EventEmitter ee_batch; int batch_item_sum = 0; int batch_item_calls = 0;
+  std::vector<int> batch_seen; int batch_span_calls = 0; int batch_once_value = -1;
+  ee_batch.on("batch", [&](int v) { batch_item_sum += v; batch_item_calls++; });
+  ee_batch.on("batch", [&](std::span<const int> items) {
+    batch_span_calls++;
+    batch_seen.insert(batch_seen.end(), items.begin(), items.end());
+  });
+  ee_batch.once("batch", [&](const int& v) { batch_once_value = v; });
+  std::vector<int> batch_items = {1, 2, 3, 4};
+  ee_batch.emitBatch("batch", batch_items);
+  ASSERT("emitBatch: item listener called once per item", batch_item_calls == 4 && batch_item_sum == 10);
+  ASSERT("emitBatch: span listener called once with the whole batch", batch_span_calls == 1 && batch_seen == batch_items);
+  ASSERT("emitBatch: once listener gets only the first item", batch_once_value == 1 && ee_batch.listeners() == 2);
+  int batch_array[] = {5, 6};
+  ee_batch.emitBatch("batch", batch_array);
+  ee_batch.emitBatch("batch", std::span<const int>());
+  ASSERT("emitBatch: arrays accepted, empty batches ignored", batch_span_calls == 2 && batch_item_sum == 21);
+  ee_batch.emit("batch", 7);
+  ASSERT("emitBatch: span listener sees a plain emit as a batch of one", batch_span_calls == 3 && batch_seen.back() == 7);
+  ASSERT("emitBatch: item listener still gets plain emits", batch_item_sum == 28);
+
+  /// - Test #30: Subscription removes exactly one listener
+  EventEmitter ee_sub; int sub_a = 0, sub_b = 0, sub_c = 0;
+  auto sub_first = ee_sub.on("sub", [&](int v) { sub_a += v; });
+  ee_sub.on("sub", [&](int v) { sub_b += v; });
+  auto sub_third = ee_sub.once("sub", [&](int v) { sub_c += v; });
+  ASSERT("Subscription: active after on()", sub_first.active() && sub_third.active());
+  ASSERT("Subscription: unsubscribe removes the listener", sub_first.unsubscribe() && ee_sub.listeners() == 2);
+  ASSERT("Subscription: unsubscribe is idempotent", !sub_first.unsubscribe() && !sub_first.active());
+  ee_sub.emit("sub", 1);
+  ASSERT("Subscription: other listeners still fire", sub_a == 0 && sub_b == 1 && sub_c == 1);
+  ASSERT("Subscription: fired once listener is no longer active", !sub_third.active() && !sub_third.unsubscribe());
+  ASSERT("Subscription: empty token does nothing", !EventEmitter::Subscription().unsubscribe());
+
+  EventEmitter::Subscription sub_self, sub_later; int sub_self_calls = 0, sub_after = 0;
+  sub_self = ee_sub.on("self", [&](int) { sub_self_calls++; sub_self.unsubscribe(); sub_later.unsubscribe(); });
+  sub_later = ee_sub.on("self", [&](int) { sub_after++; });
+  ee_sub.emit("self", 0);
+  ee_sub.emit("self", 0);
+  ASSERT("Subscription: listener can unsubscribe itself during emit", sub_self_calls == 1);
+  ASSERT("Subscription: listener removed during emit is skipped by that emit", sub_after == 0);
+
+  int sub_scoped = 0;
+  {
+    EventEmitter::ScopedSubscription scoped = ee_sub.on("scoped", [&]() { sub_scoped++; });
+    ee_sub.emit("scoped");
+  }
+  ee_sub.emit("scoped");
+  ASSERT("ScopedSubscription: unsubscribes when it goes out of scope", sub_scoped == 1);
+
+  auto sub_wiped = ee_sub.on("wiped", [&]() {});
+  ee_sub.off("wiped");
+  auto sub_reused = ee_sub.on("wiped", [&]() {});
+  ASSERT("Subscription: off() invalidates the token", !sub_wiped.active() && !sub_wiped.unsubscribe());
+  ASSERT("Subscription: stale token cannot remove a listener reusing its slot", sub_reused.active());
+
+  std::vector<EventEmitter::Subscription> sub_many; int sub_many_sum = 0;
+  ee_sub.maxListeners = 200;
+  for (int i = 0; i < 100; ++i) {
+    sub_many.push_back(ee_sub.on("many", [&sub_many_sum, i](int) { sub_many_sum += i; }));
+  }
+  for (int i = 0; i < 100; i += 2) sub_many[i].unsubscribe();
+  ee_sub.emit("many", 0);
+  ASSERT("Subscription: survivors fire after many removals", sub_many_sum == 2500);
+  int sub_req_calls = 0;
+  for (int i = 0; i < 20000; ++i) {
+    ee_sub.on("request." + std::to_string(i), [&]() { sub_req_calls++; }).unsubscribe();
+  }
+  ee_sub.on("request.7", [&]() { sub_req_calls++; });
+  ee_sub.emit("request.7");
+  ee_sub.emit("request.8");
+  ASSERT("Subscription: names emptied by unsubscribing can be listened to again", sub_req_calls == 1);
+
+  /// - Test #31: once listeners fire exactly once, even under concurrent emits
+  EventEmitter ee_once_race;
+  const int ONCE_RACE_LISTENERS = 200, ONCE_RACE_THREADS = 4;
+  ee_once_race.maxListeners = ONCE_RACE_LISTENERS;
+  std::vector<std::atomic<int>> once_race_calls(ONCE_RACE_LISTENERS);
+  for (int i = 0; i < ONCE_RACE_LISTENERS; ++i) {
+    ee_once_race.once("race", [&once_race_calls, i]() { once_race_calls[i]++; });
+  }
+  std::vector<std::thread> once_race_threads;
+  for (int t = 0; t < ONCE_RACE_THREADS; ++t) {
+    once_race_threads.emplace_back([&]() { for (int i = 0; i < 50; ++i) ee_once_race.emit("race"); });
+  }
+  for (auto& t : once_race_threads) t.join();
+  bool once_race_exact = true;
+  for (auto& calls : once_race_calls) once_race_exact = once_race_exact && calls.load() == 1;
+  ASSERT("once: each listener fires exactly once across racing emits", once_race_exact);
+  ASSERT("once: listener count drops as soon as they fire", ee_once_race.listeners() == 0);
+  int once_race_again = 0;
+  ee_once_race.on("race.next", [&]() { once_race_again++; });
+  ee_once_race.once("race", [&]() { once_race_again++; });
+  ee_once_race.emit("race");
+  ee_once_race.emit("race");
+  ee_once_race.emit("race.next");
+  ASSERT("once: a name emptied by racing emits can be listened to again", once_race_again == 2);
+
+  EventEmitter ee_once_late; int once_late_calls = 0; bool once_late_added = false;
+  ee_once_late.on("late", [&]() {
+    if (!once_late_added) {
+      once_late_added = true;
+      ee_once_late.once("late", [&]() { once_late_calls++; });
+    }
+  });
+  ee_once_late.emit("late");
+  ASSERT("once: listener added during an emit is not dropped by it", once_late_calls == 0 && ee_once_late.listeners() == 2);
+  ee_once_late.emit("late");
+  ee_once_late.emit("late");
+  ASSERT("once: late listener fires on the next emit, then never again", once_late_calls == 1 && ee_once_late.listeners() == 1);
+
+  EventEmitter ee_once_mismatch; int once_mismatch_calls = 0;
+  ee_once_mismatch.once("typed", [&](int) { once_mismatch_calls++; });
+  std::stringstream once_mismatch_err;
+  std::streambuf* once_old_cerr = std::cerr.rdbuf(once_mismatch_err.rdbuf());
+  ee_once_mismatch.emit("typed", std::string("wrong"));
+  std::cerr.rdbuf(once_old_cerr);
+  ASSERT("once: mismatched emit does not use up the listener", ee_once_mismatch.listeners() == 1);
+  ee_once_mismatch.emit("typed", 1);
+  ASSERT("once: listener fires on the first matching emit", once_mismatch_calls == 1 && ee_once_mismatch.listeners() == 0);
+
+  /// - Test #32: stats() and the leak warning handler
+#if EVENTEMITTER_STATS
+  ASSERT("stats: compiled in for the test suite", EventEmitter::stats_enabled);
+  EventEmitter ee_stats;
+  ee_stats.on("metered", [](int) {});
+  ee_stats.once("metered", [](int) {});
+  ee_stats.emit("metered", 1);
+  ee_stats.emit("metered", 2);
+  std::vector<int> stats_batch = {3, 4, 5};
+  ee_stats.emitBatch("metered", stats_batch);
+  ee_stats.id("quiet");
+  EventEmitter::Stats stats = ee_stats.stats();
+  ASSERT("stats: one entry per interned event", stats.events.size() == 2 && stats.events[0].name == "metered" && stats.events[1].name == "quiet");
+  ASSERT("stats: emits counted, batch items included", stats.events[0].emits == 5 && stats.events[1].emits == 0);
+  ASSERT("stats: only current listeners reported", stats.events[0].listeners.size() == 1 && !stats.events[0].listeners[0].once);
+  ASSERT("stats: every listener call timed", stats.events[0].listeners[0].call_ns.count() == 5);
+  ASSERT("stats: allocations and snapshots counted", stats.listeners_allocated == 2 && stats.snapshots_published >= 2);
+  ee_stats.on("gone", []() {});
+  ee_stats.off("gone");
+  ASSERT("stats: released events are left out", ee_stats.stats().events.size() == 2);
+
+  EventEmitter ee_shards;
+  for (int i = 0; i < 100; ++i) {
+    ee_shards.id("metric." + std::to_string(i));
+  }
+  for (int t = 0; t < 4; ++t) {
+    for (int l = 0; l < 4; ++l) {
+      ee_shards.id("perf_event_t" + std::to_string(t) + "_l" + std::to_string(l));
+    }
+  }
+  std::vector<int> metric_shards(16), perf_shards(16);
+  for (const auto& event : ee_shards.stats().events) {
+    (event.name.starts_with("metric.") ? metric_shards : perf_shards)[event.shard]++;
+  }
+  ASSERT("stats: names differing in a numeric suffix spread across the shards",
+         std::count(metric_shards.begin(), metric_shards.end(), 0) <= 1 &&
+         *std::max_element(metric_shards.begin(), metric_shards.end()) <= 14 &&
+         std::count(perf_shards.begin(), perf_shards.end(), 0) <= 8);
+#else
+  EventEmitter ee_stats;
+  ee_stats.on("metered", [](int) {});
+  ee_stats.emit("metered", 1);
+  EventEmitter::Stats stats = ee_stats.stats();
+  ASSERT("stats: compiled out by default, and the snapshot is empty",
+         !EventEmitter::stats_enabled && stats.events.empty() && stats.listeners_allocated == 0 && stats.snapshots_published == 0);
+#endif
+
+  EventEmitter::Histogram histogram;
+  for (std::uint64_t v = 1; v <= 1000; ++v) histogram.record(v);
+  ASSERT("Histogram: counts every value", histogram.count() == 1000);
+  ASSERT("Histogram: percentiles within one sub-bucket", histogram.percentile(50) >= 500 && histogram.percentile(50) <= 625);
+  ASSERT("Histogram: small values are exact", EventEmitter::Histogram::bucket_limit(EventEmitter::Histogram::bucket_of(3)) == 3);
+  ASSERT("Histogram: bucket limits bound their values",
+         EventEmitter::Histogram::bucket_limit(EventEmitter::Histogram::bucket_of(1000)) >= 1000 &&
+         EventEmitter::Histogram::bucket_limit(EventEmitter::Histogram::bucket_of(1000)) < 1250);
+
+  EventEmitter ee_leak; std::vector<EventEmitter::LeakWarning> leak_warnings; std::string leak_event; int leak_seen_count = -1;
+  ee_leak.maxListeners = 1;
+  ee_leak.setLeakWarningHandler([&](const EventEmitter::LeakWarning& warning) {
+    leak_warnings.push_back(warning);
+    leak_event = std::string(warning.event);
+    leak_seen_count = ee_leak.listeners();  // No lock is held, so the emitter can be used here.
+  });
+  std::stringstream leak_cout;
+  std::streambuf* leak_old_cout = std::cout.rdbuf(leak_cout.rdbuf());
+  ee_leak.on("leaky", []() {});
+  ee_leak.on("leaky", []() {});
+  std::cout.rdbuf(leak_old_cout);
+  ASSERT("setLeakWarningHandler: handler called instead of printing", leak_warnings.size() == 1 && leak_cout.str().empty());
+  ASSERT("setLeakWarningHandler: warning carries event and counts",
+         leak_warnings.size() == 1 && leak_event == "leaky" && leak_warnings[0].listeners == 2 && leak_warnings[0].maxListeners == 1 && leak_seen_count == 2);
+
+  /// - Test #33: steady-state emit does not allocate, and a memory resource replaces the heap
+  EventEmitter ee_alloc; long alloc_sum = 0; std::string alloc_text = "steady";
+  std::array<long, 16> alloc_big = {};  // Too big for inline storage, so this callback lives on the heap.
+  ee_alloc.on("tick", [&](int v) { alloc_sum += v; });
+  ee_alloc.on("tick", [&, alloc_big](int v) { alloc_sum += v + alloc_big[0]; });
+  ee_alloc.on("text", [&](const std::string& text) { alloc_sum += long(text.size()); });
+  ee_alloc.once("tick", [&](int) { alloc_sum += 1000; });
+  EventEmitter::EventId alloc_tick = ee_alloc.id("tick");
+  std::vector<int> alloc_batch = {1, 2, 3};
+  ee_alloc.emit("tick", 1);  // Warm-up: fires the once listener.
+  TypedEmitter<eventemitter::Event<"tick", void(int)>> typed_alloc; long typed_alloc_sum = 0;
+  typed_alloc.on<"tick">([&](int v) { typed_alloc_sum += v; });
+
+  long allocations_before = heap_allocations.load();
+  for (int i = 0; i < 1000; ++i) {
+    ee_alloc.emit("tick", i);
+    ee_alloc.emit(alloc_tick, i);
+    ee_alloc.emit("text", alloc_text);
+    ee_alloc.emit("unheard", i);
+    ee_alloc.emitBatch("tick", alloc_batch);
+    typed_alloc.emit<"tick">(i);
+  }
+  long steady_allocations = heap_allocations.load() - allocations_before;
+  ASSERT("allocation: steady-state emit allocates nothing", steady_allocations == 0);
+  ASSERT("allocation: listeners still ran", alloc_sum > 0 && typed_alloc_sum == 499500);
+
+  alignas(64) static std::byte arena_buffer[1 << 16];
+  std::pmr::monotonic_buffer_resource arena(arena_buffer, sizeof(arena_buffer), std::pmr::null_memory_resource());
+  long arena_allocations_before = heap_allocations.load();
+  long arena_sum = 0;
+  {
+    EventEmitter ee_arena(&arena);
+    EventEmitter::Subscription arena_sub = ee_arena.on("tick", [&, alloc_big](int v) { arena_sum += v + alloc_big[0]; });
+    ee_arena.on("tick", [&](int v) { arena_sum += v; });
+    ee_arena.once("tick", [&](int v) { arena_sum += v; });
+    ee_arena.emit("tick", 1);
+    arena_sub.unsubscribe();
+    ee_arena.emit("tick", 10);
+    ee_arena.off();
+  }
+  long arena_allocations = heap_allocations.load() - arena_allocations_before;
+  ASSERT("allocation: emitter on a memory resource never touches the heap", arena_allocations == 0);
+  ASSERT("allocation: emitter on a memory resource works", arena_sum == 13);
+
+  {
+    CountingResource req_memory;
+    EventEmitter req_ee(&req_memory);
+    int req_calls = 0;
+    auto request = [&](int i) {
+      std::string name = "request." + std::to_string(i);
+      req_ee.on(name, [&]() { req_calls++; });
+      req_ee.emit(name);
+      req_ee.off(name);
+    };
+    for (int i = 0; i < 100; ++i) {
+      request(i);
+    }
+    std::size_t req_bytes = req_memory.outstanding.load();
+    for (int i = 100; i < 20000; ++i) {
+      request(i);
+    }
+    // Some slack for retire lists that have grown; 19900 kept events would take over a megabyte.
+    ASSERT("allocation: memory stays flat while request names come and go",
+           req_calls == 20000 && req_memory.outstanding.load() <= req_bytes + 4096);
+
+    for (int i = 0; i < 20000; ++i) {
+      std::string name = "reply." + std::to_string(i);
+      req_ee.once(name, [&]() { req_calls++; });
+      req_ee.emit(name);
+    }
+    for (int i = 0; i < 20000; ++i) {
+      req_ee.on("request." + std::to_string(i), [&]() { req_calls++; }).unsubscribe();
+    }
+    ASSERT("allocation: fired once listeners and unsubscribes release their events too",
+           req_calls == 40000 && req_memory.outstanding.load() <= req_bytes + 4096);
+  }
+
+  /// - Test #34: wildcard patterns
+  EventEmitter ee_wild; std::vector<std::string> wild_calls;
+  ee_wild.on("order.fill.NYSE", [&](int) { wild_calls.push_back("exact"); });
+  ee_wild.on("order.*", [&](int) { wild_calls.push_back("order.*"); });
+  ee_wild.on("order.**", [&](int) { wild_calls.push_back("order.**"); });
+  EventEmitter::Subscription wild_mid = ee_wild.on("*.fill.*", [&](int) { wild_calls.push_back("*.fill.*"); });
+  ee_wild.on("**.NYSE", [&](int) { wild_calls.push_back("**.NYSE"); });
+  ASSERT("wildcard: each pattern counts as one listener", ee_wild.listeners() == 5);
+
+  ee_wild.emit("order.fill.NYSE", 1);
+  ASSERT("wildcard: known name gets exact and matching patterns, in registration order",
+         (wild_calls == std::vector<std::string>{"exact", "order.**", "*.fill.*", "**.NYSE"}));
+  wild_calls.clear();
+  ee_wild.emit("order.fill", 1);
+  ASSERT("wildcard: * matches exactly one segment", (wild_calls == std::vector<std::string>{"order.*", "order.**"}));
+  wild_calls.clear();
+  ee_wild.emit("order", 1);
+  ASSERT("wildcard: ** matches zero segments", (wild_calls == std::vector<std::string>{"order.**"}));
+  wild_calls.clear();
+  ee_wild.emit("orders.fill.LSE", 1);
+  ee_wild.emit("NYSE", 1);
+  ASSERT("wildcard: segments are matched whole, ** may be leading",
+         (wild_calls == std::vector<std::string>{"*.fill.*", "**.NYSE"}));
+  wild_calls.clear();
+
+  ee_wild.on("order.fill", [&](int) { wild_calls.push_back("late exact"); });
+  ee_wild.on("*.fill", [&](int) { wild_calls.push_back("late *.fill"); });
+  ee_wild.emit("order.fill", 1);
+  ASSERT("wildcard: pattern registered after a name was seen still applies to it",
+         (wild_calls == std::vector<std::string>{"order.*", "order.**", "late exact", "late *.fill"}));
+  wild_calls.clear();
+
+  ASSERT("wildcard: unsubscribe removes a pattern everywhere", wild_mid.unsubscribe() && !wild_mid.active() && !wild_mid.unsubscribe());
+  ee_wild.emit("order.fill.NYSE", 1);
+  ee_wild.emit("x.fill.y", 1);
+  ASSERT("wildcard: removed pattern no longer fires", (wild_calls == std::vector<std::string>{"exact", "order.**", "**.NYSE"}));
+  wild_calls.clear();
+
+  ee_wild.off("order.fill");
+  ee_wild.emit("order.fill", 1);
+  ASSERT("wildcard: off(name) keeps pattern listeners", (wild_calls == std::vector<std::string>{"order.*", "order.**", "late *.fill"}));
+  wild_calls.clear();
+  ee_wild.off("order.*");
+  ee_wild.emit("order.fill", 1);
+  ASSERT("wildcard: off(pattern) removes only that pattern", (wild_calls == std::vector<std::string>{"order.**", "late *.fill"}));
+  wild_calls.clear();
+
+  int wild_once_calls = 0;
+  EventEmitter::Subscription wild_once = ee_wild.once("order.**", [&](int) { wild_once_calls++; });
+  int wild_before_once = ee_wild.listeners();
+  ee_wild.emit("order.a", 1);
+  ee_wild.emit("order.b", 1);
+  ee_wild.emit("order.a", 1);
+  ASSERT("wildcard: once pattern fires for the first matching emit only", wild_once_calls == 1 && !wild_once.active());
+  ASSERT("wildcard: fired once pattern stops counting", ee_wild.listeners() == wild_before_once - 1);
+
+  long wild_sum = 0;
+  ee_wild.on("tick.**", [&](int v) { wild_sum += v; });
+  ee_wild.emit("tick.fast", 1);  // First emit of a new name resolves it.
+  long wild_allocations_before = heap_allocations.load();
+  for (int i = 0; i < 1000; ++i) ee_wild.emit("tick.fast", 1);
+  ASSERT("wildcard: emits of a seen name do not allocate", heap_allocations.load() == wild_allocations_before && wild_sum == 1001);
+
+  ee_wild.off();
+  wild_calls.clear();
+  ee_wild.emit("order.fill.NYSE", 1);
+  ee_wild.emit("tick.new", 1);
+  ASSERT("wildcard: off() removes patterns too", wild_calls.empty() && ee_wild.listeners() == 0 && wild_sum == 1001);
+
+  EventEmitter ee_wild_mt; std::atomic<long> wild_mt_all{0}; std::atomic<bool> wild_mt_done{false};
+  ee_wild_mt.on("load.*.*", [&](int) { wild_mt_all++; });
+  std::vector<std::thread> wild_mt_threads;
+  for (int t = 0; t < 4; ++t) {
+    wild_mt_threads.emplace_back([&, t]() {
+      for (int i = 0; i < 2000; ++i) {
+        ee_wild_mt.emit("load." + std::to_string(t) + "." + std::to_string(i % 64), i);
+      }
+    });
+  }
+  std::thread wild_mt_churn([&]() {
+    while (!wild_mt_done.load()) {
+      EventEmitter::Subscription sub = ee_wild_mt.on("load.**", [](int) {});
+      sub.unsubscribe();
+    }
+  });
+  for (auto& thread : wild_mt_threads) thread.join();
+  wild_mt_done = true;
+  wild_mt_churn.join();
+  ASSERT("wildcard: concurrent emits of new names and pattern churn lose no events", wild_mt_all.load() == 4 * 2000 && ee_wild_mt.listeners() == 1);
+
+  EventEmitter ee_wild_names; int wild_names_calls = 0;
+  ee_wild_names.on("order.**", [&](int) { wild_names_calls++; });
+  for (int i = 0; i < 1000; ++i) ee_wild_names.emit("request." + std::to_string(i), i);
+  ee_wild_names.emit("order.new", 1);
+  ASSERT("wildcard: only names some pattern matches are interned",
+         (!EventEmitter::stats_enabled || ee_wild_names.stats().events.size() == 1) && wild_names_calls == 1);
+  std::string wild_unmatched = "request.7";
+  ee_wild_names.emit(wild_unmatched, 1);
+  long wild_names_allocations = heap_allocations.load();
+  for (int i = 0; i < 1000; ++i) ee_wild_names.emit(wild_unmatched, 1);
+  ASSERT("wildcard: emits of a name no pattern matches do not allocate", heap_allocations.load() == wild_names_allocations);
+  ee_wild_names.on("request.*", [&](int) { wild_names_calls++; });
+  ee_wild_names.emit(wild_unmatched, 1);
+  ASSERT("wildcard: a pattern added later matches a name it did not match before", wild_names_calls == 2);
+
+  /// - Test #35: priorities and stopping propagation
+  using Propagation = EventEmitter::Propagation;
+  EventEmitter ee_prio; std::string prio_order;
+  ee_prio.on("run", [&]() { prio_order += "a"; });
+  ee_prio.on("run", [&]() { prio_order += "b"; }, 10);
+  ee_prio.on("run", [&]() { prio_order += "c"; });
+  EventEmitter::Subscription prio_d = ee_prio.on("run", [&]() { prio_order += "d"; }, 10);
+  ee_prio.on(ee_prio.id("run"), [&]() { prio_order += "e"; }, -5);
+  ee_prio.emit("run");
+  ASSERT("priority: higher priorities run first, ties in registration order", prio_order == "bdace");
+  prio_order.clear();
+  prio_d.unsubscribe();
+  ee_prio.on("run", [&]() { prio_order += "f"; }, 10);
+  ee_prio.emit("run");
+  ASSERT("priority: order kept across removals", prio_order == "bface");
+
+  EventEmitter ee_stop; int stop_downstream = 0; int stop_filtered = 0;
+  ee_stop.on("msg", [&](int) { stop_downstream++; });
+  ee_stop.on("msg", [&](int v) {
+    if (v < 0) { stop_filtered++; return Propagation::Stop; }
+    return Propagation::Continue;
+  }, 100);
+  ee_stop.on("msg", [&](int) { return true; });  // Other results are ignored.
+  ee_stop.emit("msg", 1);
+  ee_stop.emit("msg", -1);
+  ee_stop.emit("msg", 2);
+  ASSERT("stop: Propagation::Stop skips the listeners after it", stop_downstream == 2 && stop_filtered == 1);
+
+  std::vector<int> stop_items; std::vector<std::size_t> stop_spans;
+  ee_stop.on("msg", [&](const int& v) { stop_items.push_back(v); });
+  ee_stop.on("msg", [&](std::span<const int> items) { stop_spans.push_back(items.size()); });
+  std::vector<int> stop_batch = {1, -2, 3};
+  ee_stop.emitBatch("msg", stop_batch);
+  ASSERT("stop: emitBatch stops items one at a time", (stop_items == std::vector<int>{1, 3}) && (stop_spans == std::vector<std::size_t>{1, 1}));
+
+  EventEmitter ee_stop_once; int stop_once_after = 0;
+  ee_stop_once.once("gate", [&](std::string&& text) { return text.empty() ? Propagation::Continue : Propagation::Stop; }, 1);
+  ee_stop_once.on("gate", [&](std::string&&) { stop_once_after++; });
+  ee_stop_once.emit("gate", std::string("closed"));
+  ee_stop_once.emit("gate", std::string("open"));
+  ASSERT("stop: once listener with rvalue parameter stops only the emit it fires on", stop_once_after == 1);
+
+  EventEmitter ee_stop_wild; int stop_wild_after = 0;
+  ee_stop_wild.on("order.fill", [&](int) { stop_wild_after++; });
+  ee_stop_wild.on("order.*", [&](int v) { return v == 0 ? Propagation::Stop : Propagation::Continue; }, 50);
+  ee_stop_wild.emit("order.fill", 0);
+  ee_stop_wild.emit("order.fill", 1);
+  ASSERT("stop: a high-priority pattern listener can filter an exact one", stop_wild_after == 1);
+
+  TypedEmitter<eventemitter::Event<"quote", void(int)>> typed_stop; int typed_stop_after = 0;
+  typed_stop.on<"quote">([&](int) { typed_stop_after++; });
+  typed_stop.on<"quote">([&](int v) { return v > 100 ? Propagation::Stop : Propagation::Continue; }, 1);
+  typed_stop.emit<"quote">(50);
+  typed_stop.emit<"quote">(500);
+  ASSERT("stop: TypedEmitter honours priority and Propagation", typed_stop_after == 1);
+
+  /// - Test #36: awaiting events and coroutine listeners
+  EventEmitter ee_co; std::atomic<long> co_sum{0};
+  ee_co.id("ready");
+  const int co_waiters = 5000;
+  long co_allocations = heap_allocations.load();
+  for (int i = 0; i < co_waiters; ++i) {
+    wait_for_ready(ee_co, co_sum);
+  }
+  ASSERT("next: waiting allocates only the coroutine frames", heap_allocations.load() - co_allocations == co_waiters);
+  ASSERT("next: waiters stay suspended until the emit", co_sum == 0);
+  ee_co.emit("ready", 2);
+  ASSERT("next: one emit resumes every waiter", co_sum == 2 * co_waiters);
+  ee_co.emit("ready", 2);
+  ASSERT("next: a resumed waiter is not resumed again", co_sum == 2 * co_waiters);
+
+  int co_id = 0; std::string co_text;
+  wait_for_pair(ee_co, co_id, co_text);
+  ee_co.emit("pair", 7, std::string("seven"));
+  ASSERT("next: several arguments arrive as a tuple", co_id == 7 && co_text == "seven");
+
+  std::stringstream co_err;
+  std::streambuf* co_old_cerr = std::cerr.rdbuf(co_err.rdbuf());
+  wait_for_ready(ee_co, co_sum);
+  ee_co.emit("ready", std::string("wrong"));
+  std::cerr.rdbuf(co_old_cerr);
+  ASSERT("next: a waiter ignores emits with other arguments", co_sum == 2 * co_waiters && co_err.str().find("mismatch") != std::string::npos);
+  ee_co.emit("ready", 1);
+  ASSERT("next: ...and resumes on the next matching one", co_sum == 2 * co_waiters + 1);
+
+  EventEmitter ee_co_held; std::atomic<long> co_held_sum{0};
+  wait_for_ready(ee_co_held, co_held_sum);
+  ee_co_held.off("ready");
+  ee_co_held.emit("ready", 3);
+  ASSERT("next: an event a coroutine waits on is not released", co_held_sum == 3);
+
+  EventEmitter ee_co_mt; std::atomic<int> co_resumed{0}; std::atomic<bool> co_stop{false};
+  const int co_threads = 4, co_per_thread = 500, co_rounds = 3;
+  std::thread co_emitter([&]() {
+    while (!co_stop.load()) {
+      ee_co_mt.emit("go");
+    }
+  });
+  std::vector<std::thread> co_starters;
+  for (int t = 0; t < co_threads; ++t) {
+    co_starters.emplace_back([&]() {
+      for (int i = 0; i < co_per_thread; ++i) {
+        wait_repeatedly(ee_co_mt, co_rounds, co_resumed);
+      }
+    });
+  }
+  for (auto& starter : co_starters) {
+    starter.join();
+  }
+  while (co_resumed.load() < co_threads * co_per_thread * co_rounds) {
+    std::this_thread::yield();
+  }
+  co_stop = true;
+  co_emitter.join();
+  ASSERT("next: waiters added from many threads all resume", co_resumed == co_threads * co_per_thread * co_rounds);
+
+  EventEmitter ee_task; std::atomic<int> task_done{0}; std::atomic<int> task_finished{0}; std::atomic<int> task_ok{0};
+  ee_task.on("job", [&](int job) -> EventEmitter::Task {
+    co_await ee_task.next<>("release");
+    task_done += job;
+  });
+  const int task_jobs = 2000;
+  for (int i = 1; i <= task_jobs; ++i) {
+    await_emit(ee_task, i, task_finished, task_ok);
+  }
+  ee_task.drain();
+  ASSERT("emitAwait: waits for coroutine listeners to finish", task_finished == 0 && task_done == 0);
+  ee_task.emit("release");
+  ASSERT("emitAwait: resumes once every coroutine listener has finished",
+         task_finished == task_jobs && task_ok == task_jobs && task_done == task_jobs * (task_jobs + 1) / 2);
+
+  std::atomic<int> task_plain{0};
+  ee_task.on("plain", [&]() -> EventEmitter::Task {
+    task_plain++;
+    co_return;
+  });
+  ee_task.emit("plain");
+  ASSERT("Task: a plain emit starts coroutine listeners too", task_plain == 1);
+
+  EventEmitter ee_task_fail;
+  ee_task_fail.configureAsync({1, 1, EventEmitter::Backpressure::Fail});
+  std::atomic<bool> task_gate{false}; std::atomic<int> task_fail_finished{0}; std::atomic<int> task_fail_ok{0};
+  ee_task_fail.on("hold", [&]() {
+    while (!task_gate.load()) std::this_thread::yield();
+  });
+  ee_task_fail.on("job", [](int) {});
+  ee_task_fail.emitAsync("hold");
+  for (int i = 0; i < 8; ++i) {
+    await_emit(ee_task_fail, i, task_fail_finished, task_fail_ok);
+  }
+  ASSERT("emitAwait: a rejected emit resumes at once with false", task_fail_finished >= 7 && task_fail_ok <= 1);
+  task_gate = true;
+  ee_task_fail.drain();
+  ASSERT("emitAwait: every await resumes", task_fail_finished == 8);
+
+#if defined(__linux__)  // SharedMemoryEmitter is Linux only.
+  /// - Test #37: SharedMemoryEmitter across processes
+  std::string shm_name = "/eventemitter-test-" + std::to_string(getpid());
+  SharedMemoryEmitter::unlink(shm_name);
+  {
+    SharedMemoryEmitter shm_bus(shm_name, {1024, true});
+    std::atomic<int> shm_ready{0}; std::atomic<long> shm_seen{0};
+    shm_bus.on("ready", [&](int) { shm_ready++; });
+    shm_bus.on("tick", [&](int, int) { shm_seen++; });
+
+    auto shm_all_succeeded = [](std::vector<std::unique_ptr<ChildProcess>>& children) {
+      bool ok = true;
+      for (auto& child : children) {
+        ok = child->succeeded() && ok;
+      }
+      return ok;
+    };
+
+    std::vector<std::unique_ptr<ChildProcess>> shm_consumer_children;
+    for (int c = 0; c < SHM_CONSUMERS; ++c) {
+      shm_consumer_children.push_back(std::make_unique<ChildProcess>("consumer", shm_name, c));
+    }
+    bool shm_consumers_alive = true;
+    while (shm_ready.load() < SHM_CONSUMERS && shm_consumers_alive) {
+      for (auto& child : shm_consumer_children) {
+        shm_consumers_alive = child->running() && shm_consumers_alive;
+      }
+      std::this_thread::yield();
+    }
+    ASSERT("shm: consumer processes attached", shm_consumers_alive);
+
+    std::vector<std::unique_ptr<ChildProcess>> shm_producer_children;
+    for (int p = 0; shm_consumers_alive && p < SHM_PRODUCERS; ++p) {
+      shm_producer_children.push_back(std::make_unique<ChildProcess>("producer", shm_name, p));
+    }
+
+    bool shm_producers_ok = shm_all_succeeded(shm_producer_children);
+    shm_bus.emit("done");
+    bool shm_consumers_ok = shm_all_succeeded(shm_consumer_children);
+    shm_bus.drain();
+    ASSERT("shm: every producer process published all its emits", shm_producers_ok);
+    ASSERT("shm: every consumer process saw every emit, in order per producer", shm_consumers_ok);
+    ASSERT("shm: the emitting process's own listeners see the bus too", shm_seen == long(SHM_PRODUCERS) * SHM_EMITS);
+
+    std::stringstream shm_err;
+    std::streambuf* shm_old_cerr = std::cerr.rdbuf(shm_err.rdbuf());
+    shm_bus.emit("tick", 1.5);
+    shm_bus.drain();
+    bool shm_long_name = shm_bus.emit(std::string(SharedMemoryEmitter::MAX_NAME + 1, 'x'), 1);
+    std::cerr.rdbuf(shm_old_cerr);
+    ASSERT("shm: argument types are checked by the receiving listener", shm_seen == long(SHM_PRODUCERS) * SHM_EMITS && shm_err.str().find("mismatch") != std::string::npos);
+    ASSERT("shm: names longer than MAX_NAME are rejected", !shm_long_name && shm_err.str().find("Name longer") != std::string::npos);
+    auto shm_emits_long = [](auto& bus) { return requires { bus.emit("a.name.that.is.longer.than.36.bytes.x", 1); }; };
+    auto shm_emits_36 = [](auto& bus) { return requires { bus.emit("a.name.of.exactly.36.bytes..........", 1); }; };
+    ASSERT("shm: string literal names longer than MAX_NAME do not compile", !shm_emits_long(shm_bus) && shm_emits_36(shm_bus));
+
+    std::atomic<int> shm_counted{0};
+    shm_bus.on("count", [&shm_counted, count = 0](int) mutable { shm_counted = ++count; });
+    shm_bus.emit("count", 1);
+    shm_bus.emit("count", 2);
+    shm_bus.drain();
+    ASSERT("shm: a mutable lambda listener keeps its own state", shm_counted == 2);
+  }
+  SharedMemoryEmitter::unlink(shm_name);
+
+  std::string shm_full_name = shm_name + "-full";
+  SharedMemoryEmitter::unlink(shm_full_name);
+  {
+    SharedMemoryEmitter shm_full(shm_full_name, {16, false});
+    std::atomic<bool> shm_entered{false}; std::atomic<bool> shm_release{false};
+    shm_full.on("slow", [&](int) {
+      shm_entered = true;
+      while (!shm_release.load()) std::this_thread::yield();
+    });
+    shm_full.emit("slow", 0);
+    while (!shm_entered.load()) std::this_thread::yield();
+    int shm_accepted = 1;
+    while (shm_accepted < 100 && shm_full.emit("slow", shm_accepted)) shm_accepted++;
+    ASSERT("shm: without block_when_full, emit fails once a reader is a full ring behind", shm_accepted == 16);
+    shm_release = true;
+    shm_full.drain();
+  }
+  SharedMemoryEmitter::unlink(shm_full_name);
+
+#ifndef TEST_THREAD_SANITIZER  // Needs processes that really die.
+  std::string shm_dead_name = shm_name + "-dead";
+  SharedMemoryEmitter::unlink(shm_dead_name);
+  {
+    SharedMemoryEmitter shm_bus(shm_dead_name, {16, true});
+    std::atomic<int> shm_got{0}; std::atomic<long> shm_sum{0};
+    shm_bus.on("tick", [&](int v) { shm_got++; shm_sum += v; });
+
+    // A reader that never detaches: once it is reaped the ring drains again.
+    ChildProcess("dead-reader", shm_dead_name, 0).wait();
+    std::atomic<bool> shm_emitted{false};
+    std::thread shm_emitter([&]() {
+      for (int i = 0; i < 100; ++i) shm_bus.emit("tick", 1);
+      shm_emitted = true;
+    });
+    for (int waited = 0; !shm_emitted.load() && waited < 10000; ++waited) {
+      std::this_thread::sleep_for(std::chrono::milliseconds(1));
+    }
+    ASSERT("shm: a dead reader does not hold the ring full", shm_emitted.load());
+    if (!shm_emitted.load()) {
+      std::cout << "shm: emitter is stuck, giving up" << std::endl;
+      std::_Exit(1);
+    }
+    shm_emitter.join();
+    shm_bus.drain();
+
+    // A producer that dies between claiming a slot and publishing it.
+    int shm_status = ChildProcess("dead-producer", shm_dead_name, 0).wait();
+    shm_bus.emit("tick", 1000);
+    shm_bus.drain();
+    ASSERT("shm: test producer died mid-emit", WIFSIGNALED(shm_status));
+    ASSERT("shm: readers skip a slot whose producer died", shm_got == 101 && shm_sum == 1100);
+  }
+  SharedMemoryEmitter::unlink(shm_dead_name);
+#endif
+#endif
+
+  /// - Test #38: Recording and replaying emits
+  std::string log_path = "/tmp/eventemitter-test-" + std::to_string(getpid()) + ".evlog";
+  {
+    EventEmitter rec_source;
+    std::atomic<int> rec_live{0};
+    rec_source.on("int", [&](int) { rec_live++; });
+    {
+      EventRecorder recorder(log_path, 256);  // Small, so buffers fill and chunks interleave.
+      rec_source.record(&recorder);
+      rec_source.emit("int", 7);
+      rec_source.emit("mixed", std::string("hello"), 2.5);
+      rec_source.emit("empty");
+      rec_source.emit("literal", "text");
+      rec_source.emit("point", Point{3, 4.5});
+      rec_source.emit("tagged", Tagged{"primes", {2, 3, 5, 7}});
+      rec_source.emit("vector", std::vector<int>{1, 2});  // No serializer: skipped.
+      rec_source.emit("long", std::string(1000, 'x'));    // Larger than a buffer.
+      ASSERT("record: emits without a serializer are counted as skipped", recorder.skipped() == 1);
+
+      std::vector<std::thread> rec_threads;
+      for (int t = 0; t < 4; ++t) {
+        rec_threads.emplace_back([&rec_source, t]() {
+          for (int i = 0; i < 500; ++i) {
+            rec_source.emit("seq", t, i);
+          }
+        });
+      }
+      for (auto& th : rec_threads) th.join();
+      rec_source.emitAsync("async", 11);
+      rec_source.record(nullptr);
+      rec_source.emit("int", 8);  // Detached: not recorded.
+    }
+    ASSERT("record: listeners still run while recording", rec_live == 2);
+
+    EventEmitter rec_target;
+    int rec_int = 0; std::string rec_text; double rec_double = 0; int rec_empty = 0;
+    std::string rec_literal; Point rec_point{}; Tagged rec_tagged; std::size_t rec_long = 0; int rec_async = 0;
+    std::array<int, 4> rec_next{}; bool rec_ordered = true; int rec_seq = 0;
+    rec_target.on("int", [&](int v) { rec_int = v; });
+    rec_target.on("mixed", [&](std::string s, double d) { rec_text = s; rec_double = d; });
+    rec_target.on("empty", [&]() { rec_empty++; });
+    rec_target.on("literal", [&](const char* s) { rec_literal = s; });
+    rec_target.on("point", [&](Point p) { rec_point = p; });
+    rec_target.on("tagged", [&](const Tagged& t) { rec_tagged = t; });
+    rec_target.on("long", [&](const std::string& s) { rec_long = s.size(); });
+    rec_target.on("async", [&](int v) { rec_async = v; });
+    rec_target.on("seq", [&](int t, int i) {
+      rec_ordered = rec_ordered && rec_next[t] == i;
+      rec_next[t] = i + 1;
+      rec_seq++;
+    });
+
+    EventReplay replay(log_path);
+    ASSERT("replay: the log holds every recorded emit", replay.size() == 2008);
+    ASSERT("replay: every emit is replayed", replay.run(rec_target) == 2008);
+    ASSERT("replay: int argument", rec_int == 7);
+    ASSERT("replay: std::string and double arguments", rec_text == "hello" && rec_double == 2.5);
+    ASSERT("replay: no arguments", rec_empty == 1);
+    ASSERT("replay: string literal", rec_literal == "text");
+    ASSERT("replay: trivially copyable struct", rec_point.x == 3 && rec_point.y == 4.5);
+    ASSERT("replay: custom EventSerializer", rec_tagged.label == "primes" && rec_tagged.values == std::vector<int>({2, 3, 5, 7}));
+    ASSERT("replay: a record larger than the buffer", rec_long == 1000);
+    ASSERT("replay: emitAsync is recorded", rec_async == 11);
+    ASSERT("replay: every thread's emits arrive in their order", rec_ordered && rec_seq == 2000);
+  }
+  {
+    EventEmitter rec_source;  // No listeners: emits are still recorded.
+    {
+      EventRecorder recorder(log_path, 64 * 1024, EventRecorder::Clock::Ticks);
+      rec_source.record(&recorder);
+      rec_source.emit("tick", 1);
+      std::this_thread::sleep_for(std::chrono::milliseconds(20));
+      rec_source.emit("tick", 2);
+      rec_source.record(nullptr);
+    }
+    EventEmitter rec_target;
+    std::vector<std::chrono::steady_clock::time_point> rec_times;
+    rec_target.on("tick", [&](int) { rec_times.push_back(std::chrono::steady_clock::now()); });
+    EventReplay replay(log_path);
+    replay.run(rec_target, EventReplay::Timing::Original);
+    ASSERT("replay: original timing keeps the gap between emits",
+      rec_times.size() == 2 && rec_times[1] - rec_times[0] >= std::chrono::milliseconds(19));
+    rec_times.clear();
+    replay.run(rec_target, EventReplay::Timing::FullSpeed);
+    ASSERT("replay: full speed does not wait",
+      rec_times.size() == 2 && rec_times[1] - rec_times[0] < std::chrono::milliseconds(19));
+  }
+  {
+    EventEmitter rec_source;
+    {
+      EventRecorder recorder(log_path);  // The coarse clock.
+      rec_source.record(&recorder);
+      rec_source.emit("tick", 1);
+      std::this_thread::sleep_for(std::chrono::milliseconds(50));
+      rec_source.emit("tick", 2);
+      rec_source.record(nullptr);
+    }
+    EventEmitter rec_target;
+    std::vector<std::chrono::steady_clock::time_point> rec_times;
+    rec_target.on("tick", [&](int) { rec_times.push_back(std::chrono::steady_clock::now()); });
+    EventReplay replay(log_path);
+    replay.run(rec_target, EventReplay::Timing::Original);
+    ASSERT("replay: the default coarse clock keeps the gap to within its resolution",
+      rec_times.size() == 2 && rec_times[1] - rec_times[0] >= std::chrono::milliseconds(30));
+  }
+  {
+    std::FILE* file = std::fopen(log_path.c_str(), "wb");
+    std::fputs("not a log", file);
+    std::fclose(file);
+    bool rec_threw = false;
+    try {
+      EventReplay replay(log_path);
+    } catch (const std::runtime_error&) {
+      rec_threw = true;
+    }
+    ASSERT("replay: a file without the magic is rejected", rec_threw);
+  }
+  {
+    {
+      EventEmitter rec_source;
+      EventRecorder recorder(log_path);
+      rec_source.record(&recorder);
+      rec_source.emit("text", std::string("hello"));
+      rec_source.record(nullptr);
+    }
+    // Overwrite the string's length, after the file, chunk and record
+    // headers and the 4-byte name, with one that runs past the record.
+    std::FILE* file = std::fopen(log_path.c_str(), "r+b");
+    std::fseek(file, 16 + 20 + 22 + 4, SEEK_SET);
+    std::uint32_t rec_bad_length = 0x7fffffff;
+    std::fwrite(&rec_bad_length, sizeof(rec_bad_length), 1, file);
+    std::fclose(file);
+
+    EventEmitter rec_target;
+    int rec_called = 0;
+    rec_target.on("text", [&](const std::string&) { rec_called++; });
+    std::stringstream rec_err;
+    std::streambuf* rec_old_cerr = std::cerr.rdbuf(rec_err.rdbuf());
+    EventReplay replay(log_path);
+    std::size_t rec_emitted = replay.run(rec_target);
+    std::cerr.rdbuf(rec_old_cerr);
+    ASSERT("replay: a record whose argument lengths overrun it is rejected",
+      replay.size() == 1 && rec_emitted == 0 && rec_called == 0 && rec_err.str().find("Corrupt") != std::string::npos);
+  }
+  std::remove(log_path.c_str());
+
+  /// - Test #39: Executor-bound listeners
+  {
+    EventEmitter exec_ee;
+    EventEmitter::Executor exec_loop;
+    std::atomic<bool> exec_stop{false};
+    std::thread::id exec_loop_id;
+    std::atomic<bool> exec_off_thread{false};
+    std::array<int, 3> exec_next{};
+    std::atomic<bool> exec_ordered{true};
+    std::atomic<int> exec_seen{0};
+
+    exec_ee.on("work", [&](int producer, int seq) {
+      exec_off_thread = exec_off_thread || std::this_thread::get_id() != exec_loop_id;
+      exec_ordered = exec_ordered && exec_next[producer] == seq;
+      exec_next[producer] = seq + 1;
+      exec_seen++;
+    }, exec_loop);
+
+    std::thread exec_thread([&]() {
+      while (!exec_stop.load()) {
+        if (exec_loop.poll() == 0) std::this_thread::yield();
+      }
+      exec_loop.poll();
+    });
+    exec_loop_id = exec_thread.get_id();
+    std::vector<std::thread> exec_producers;
+    for (int p = 0; p < 3; ++p) {
+      exec_producers.emplace_back([&exec_ee, p]() {
+        for (int i = 0; i < 5000; ++i) exec_ee.emit("work", p, i);
+      });
+    }
+    for (auto& th : exec_producers) th.join();
+    while (exec_seen.load() < 15000) std::this_thread::yield();
+    exec_stop = true;
+    exec_thread.join();
+    ASSERT("executor: every delivery runs", exec_seen == 15000);
+    ASSERT("executor: listeners run on the polling thread only", !exec_off_thread);
+    ASSERT("executor: deliveries from one thread keep their order", exec_ordered);
+  }
+  {
+    EventEmitter exec_ee;
+    int exec_wakes = 0;
+    EventEmitter::Executor exec_loop(64, [&]() { exec_wakes++; });
+    int exec_sum = 0; std::string exec_text; int exec_once = 0; int exec_pattern = 0; int exec_inline = 0;
+    auto exec_sub = exec_ee.on("add", [&](int v) { exec_sum += v; }, exec_loop);
+    exec_ee.on("text", [&](std::string&& s) { exec_text = std::move(s); }, exec_loop);
+    exec_ee.once("first", [&]() { exec_once++; }, exec_loop);
+    exec_ee.on("job.*", [&](int) { exec_pattern++; }, exec_loop);
+    exec_ee.on("add", [&](int) { exec_inline++; });
+
+    for (int i = 1; i <= 10; ++i) exec_ee.emit("add", i);
+    exec_ee.emit("text", std::string("moved in"));
+    exec_ee.emit("first");
+    exec_ee.emit("first");
+    exec_ee.emit("job.start", 1);
+    ASSERT("executor: emit does not call bound listeners", exec_sum == 0 && exec_inline == 10);
+    ASSERT("executor: one wake-up for a batch of emits", exec_wakes == 1);
+    ASSERT("executor: poll runs the batch", exec_loop.poll() == 13);
+    ASSERT("executor: int argument", exec_sum == 55);
+    ASSERT("executor: T&& parameter gets the delivery's copy", exec_text == "moved in");
+    ASSERT("executor: once listener", exec_once == 1);
+    ASSERT("executor: pattern listener", exec_pattern == 1);
+
+    exec_ee.emit("add", 100);
+    ASSERT("executor: a polled inbox wakes again", exec_wakes == 2);
+    exec_sub.unsubscribe();
+    ASSERT("executor: deliveries of a removed listener are dropped", exec_loop.poll() == 1 && exec_sum == 55);
+
+    exec_ee.on("coro", [&](int v) -> EventEmitter::Task {
+      exec_sum += v;
+      co_return;
+    }, exec_loop);
+    exec_ee.emit("coro", 5);
+    exec_loop.poll();
+    ASSERT("executor: Task listeners are started by poll", exec_sum == 60);
+  }
+  {
+    EventEmitter exec_ee;
+    EventEmitter::Executor exec_loop(4);
+    std::vector<int> exec_order;
+    exec_ee.on("n", [&](int v) { exec_order.push_back(v); }, exec_loop);
+    exec_loop.poll();  // This thread owns the executor from here on.
+    for (int i = 0; i < 10; ++i) exec_ee.emit("n", i);
+    exec_loop.poll();
+    bool exec_in_order = exec_order.size() == 10;
+    for (int i = 0; exec_in_order && i < 10; ++i) exec_in_order = exec_order[i] == i;
+    ASSERT("executor: the owner emitting into a full inbox polls it", exec_in_order);
+  }
+  {
+    EventEmitter exec_ee;
+    EventEmitter::Executor exec_newest(4, nullptr, EventEmitter::Backpressure::DropOldest);
+    EventEmitter::Executor exec_oldest(4, nullptr, EventEmitter::Backpressure::Fail);
+    std::vector<int> exec_kept_newest, exec_kept_oldest;
+    exec_ee.on("n", [&](int v) { exec_kept_newest.push_back(v); }, exec_newest);
+    exec_ee.on("n", [&](int v) { exec_kept_oldest.push_back(v); }, exec_oldest);
+    for (int i = 0; i < 10; ++i) exec_ee.emit("n", i);  // Nobody polls: both inboxes fill.
+    exec_newest.poll();
+    exec_oldest.poll();
+    ASSERT("executor: DropOldest keeps the newest deliveries",
+      exec_kept_newest == std::vector<int>({6, 7, 8, 9}) && exec_newest.dropped() == 6);
+    ASSERT("executor: Fail keeps the oldest deliveries",
+      exec_kept_oldest == std::vector<int>({0, 1, 2, 3}) && exec_oldest.dropped() == 6);
+  }
+  {
+    EventEmitter::Executor exec_loop;
+    int exec_calls = 0;
+    {
+      EventEmitter exec_ee;
+      exec_ee.on("late", [&]() { exec_calls++; }, exec_loop);
+      exec_ee.emit("late");
+    }
+    exec_loop.poll();
+    ASSERT("executor: deliveries are dropped once their emitter is gone", exec_calls == 0);
+  }
+
   std::cout << "\nSummary\n-------" << std::endl;
   std::cout << "Total Assertions Run: " << assertions_run << std::endl;
   std::cout << "Assertions Passed:  " << assertions_passed << std::endl;